@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Shared timing harness for the SQLRand end-to-end benchmarks. Each sample
+ * application runs its workload for a number of iterations (argv[1]) and
+ * reports one line that compare.sh knows how to parse.
+ */
+
+#ifndef __SQLRAND_BENCH_H__
+#define __SQLRAND_BENCH_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_ITERATIONS 100000UL
+
+static unsigned long
+bench_iterations(int argc, char **argv)
+{
+	if (argc > 1)
+		return strtoul(argv[1], NULL, 10);
+	return BENCH_DEFAULT_ITERATIONS;
+}
+
+static unsigned long long
+bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+bench_report(const char *workload, unsigned long queries,
+	     unsigned long long elapsed_ns)
+{
+	double per_query = queries ? (double) elapsed_ns / queries : 0.0;
+	double qps = elapsed_ns ? queries * 1e9 / elapsed_ns : 0.0;
+
+	printf("workload=%s queries=%lu total_ns=%llu ns_per_query=%.1f qps=%.0f\n",
+	       workload, queries, elapsed_ns, per_query, qps);
+}
+
+#endif
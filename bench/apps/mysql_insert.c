@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Dynamically built INSERTs through mysql_real_query. The format string is
+ * a tainted literal, so the pass randomizes it and the runtime has to scan
+ * the full statement on every call.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mysql/mysql.h"
+
+#include "bench.h"
+
+int
+main(int argc, char **argv)
+{
+	unsigned long i, n = bench_iterations(argc, argv);
+	char query[256];
+	MYSQL *conn = mysql_init(NULL);
+
+	if (mysql_real_connect(conn, "localhost", "bench", "bench", "bench",
+			       0, NULL, 0) == NULL)
+		return EXIT_FAILURE;
+
+	unsigned long long start = bench_now_ns();
+	for (i = 0; i < n; i++) {
+		sprintf(query,
+			"INSERT INTO log (id, message) VALUES (%lu, 'entry %lu')",
+			i, i);
+		if (mysql_real_query(conn, query, strlen(query)))
+			return EXIT_FAILURE;
+	}
+	bench_report("mysql_insert", n, bench_now_ns() - start);
+
+	mysql_close(conn);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Bulk load through COPY ... FROM STDIN. Only the COPY command goes through
+ * the SQLRand runtime; the rows are streamed with PQputCopyData untouched.
+ * Each iteration sends one row.
+ */
+
+#include <stdio.h>
+
+#include "postgresql/libpq-fe.h"
+
+#include "bench.h"
+
+int
+main(int argc, char **argv)
+{
+	unsigned long i, n = bench_iterations(argc, argv);
+	char row[128];
+	PGconn *conn = PQconnectdb("dbname=bench");
+
+	if (PQstatus(conn) != CONNECTION_OK)
+		return EXIT_FAILURE;
+
+	unsigned long long start = bench_now_ns();
+	PGresult *res = PQexec(conn, "COPY log (id, message) FROM STDIN");
+	if (PQresultStatus(res) != PGRES_COPY_IN)
+		return EXIT_FAILURE;
+	PQclear(res);
+
+	for (i = 0; i < n; i++) {
+		int len = snprintf(row, sizeof(row), "%lu\tSELECT entry %lu\n",
+				   i, i);
+		if (PQputCopyData(conn, row, len) != 1)
+			return EXIT_FAILURE;
+	}
+	if (PQputCopyEnd(conn, NULL) != 1)
+		return EXIT_FAILURE;
+	bench_report("pq_copy", n, bench_now_ns() - start);
+
+	PQfinish(conn);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# compare.sh BUILD_DIR ITERATIONS BASE VARIANT APP...
+#
+# Runs the BASE and the VARIANT build (e.g. plain and sqlrand) of every
+# application and prints the latency and throughput delta per workload.
+
+BUILD=$1
+ITERATIONS=$2
+BASE=$3
+VARIANT=$4
+shift 4
+
+field() {
+	echo "$1" | tr ' ' '\n' | sed -n "s/^$2=//p"
+}
+
+printf "%-14s %14s %14s %12s %10s\n" \
+	workload "$BASE ns/q" "$VARIANT ns/q" "delta ns/q" overhead
+for app in "$@"; do
+	base=$("$BUILD/$app.$BASE" "$ITERATIONS") || exit 1
+	variant=$("$BUILD/$app.$VARIANT" "$ITERATIONS") || exit 1
+
+	b=$(field "$base" ns_per_query)
+	v=$(field "$variant" ns_per_query)
+	awk -v app="$app" -v b="$b" -v v="$v" 'BEGIN {
+		printf "%-14s %14.1f %14.1f %12.1f %9.1f%%\n",
+			app, b, v, v - b, b > 0 ? (v - b) * 100 / b : 0
+	}'
+done
@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# compile_time.sh BUILD_DIR CC TOLERANCE CALLS...
+#
+# Compiles the output of gen_calls.sh for every CALLS with CC (normally
+# $SS_CC) and prints the wall-clock compile time and its cost per call,
+# net of the time it takes to compile an empty block.
+# Rewriting sinks is linear in their number, so the per-call cost should
+# stay flat as CALLS grows: fails if the cost per call of the last CALLS
+# exceeds that of the first by more than TOLERANCE percent.
+
+BUILD=$1
+CC=$2
+TOLERANCE=$3
+shift 3
+
+# compile_ns CALLS: wall-clock time to compile a block of CALLS queries
+compile_ns() {
+	src="$BUILD/calls_$1.c"
+	./gen_calls.sh "$1" > "$src" || exit 1
+
+	start=$(date +%s%N)
+	$CC $INCLUDES -c -o "$BUILD/calls_$1.o" "$src" || exit 1
+	end=$(date +%s%N)
+	echo $((end - start))
+}
+
+base=$(compile_ns 0) || exit 1
+
+printf "%8s %12s %12s\n" calls "compile ms" "us/call"
+first=
+for calls in "$@"; do
+	ns=$(compile_ns "$calls") || exit 1
+	last=$(awk -v n="$calls" -v ns="$ns" -v base="$base" \
+	    'BEGIN { printf "%.2f", (ns - base) / 1e3 / n }')
+	first=${first:-$last}
+	awk -v n="$calls" -v ns="$ns" -v us="$last" 'BEGIN {
+		printf "%8d %12.1f %12s\n", n, ns / 1e6, us
+	}'
+done
+
+awk -v first="$first" -v last="$last" -v tol="$TOLERANCE" 'BEGIN {
+	if (last > first * (1 + tol / 100)) {
+		printf "cost per call grew from %.2f us to %.2f us (> %d%%)\n",
+		    first, last, tol
+		exit 1
+	}
+}'
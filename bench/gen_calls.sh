@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# gen_calls.sh CALLS
+#
+# Prints a C file whose dao_block() issues CALLS queries from a single basic
+# block, alternating literal queries and queries built with snprintf, the
+# way generated data-access code does. Used by compile_time.sh.
+
+CALLS=${1:-10000}
+
+cat <<HEAD
+#include <stdio.h>
+
+#include "mysql/mysql.h"
+
+void
+dao_block(MYSQL *db, const char *name)
+{
+	char q[256];
+
+HEAD
+
+i=0
+while [ "$i" -lt "$CALLS" ]; do
+	if [ $((i % 2)) -eq 0 ]; then
+		printf '\tmysql_query(db, "SELECT id FROM t%d WHERE a = %d");\n' \
+			"$i" "$i"
+	else
+		printf '\tsnprintf(q, sizeof(q), "SELECT id FROM t%d WHERE name = '"'"'%%s'"'"'", name);\n' "$i"
+		printf '\tmysql_query(db, q);\n'
+	fi
+	i=$((i + 1))
+done
+
+cat <<TAIL
+}
+
+int
+main(void)
+{
+	dao_block(mysql_init(NULL), "x");
+	return 0;
+}
+TAIL
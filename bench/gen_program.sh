@@ -0,0 +1,103 @@
+#!/bin/sh
+#
+# gen_program.sh FUNCS [DEPTH [INDIRECT [SOURCES [SINKS]]]]
+#
+# Prints a C program for measuring how the analysis scales. It has FUNCS
+# functions f0..f<FUNCS-1> arranged in call chains of DEPTH functions, each
+# chain started from main(). INDIRECT of the calls along the chains go
+# through the function pointer table next_fn[] instead of a direct call.
+# SOURCES functions write the query buffer (sprintf of the tainted argument
+# and strcpy of a literal, alternately) and SINKS functions execute it
+# (mysql_query and PQexec, alternately); both are spread evenly over the
+# functions. By default a quarter of the functions are sources and a quarter
+# are sinks, and no call is indirect. Used by scale.sh.
+
+FUNCS=${1:-100}
+DEPTH=${2:-8}
+INDIRECT=${3:-0}
+SOURCES=${4:-$((FUNCS / 4))}
+SINKS=${5:-$((FUNCS / 4))}
+
+awk -v n="$FUNCS" -v depth="$DEPTH" -v indirect="$INDIRECT" \
+    -v sources="$SOURCES" -v sinks="$SINKS" '
+# Whether item i of total is one of the count items picked evenly from them
+function picked(i, count, total) {
+	return int((i + 1) * count / total) > int(i * count / total)
+}
+
+function has_next(i) {
+	return i + 1 < n && (i + 1) % depth != 0
+}
+
+BEGIN {
+	if (depth < 1)
+		depth = 1
+
+	calls = 0
+	for (i = 0; i < n; i++)
+		if (has_next(i))
+			calls++
+
+	print "#include <stdio.h>"
+	print "#include <string.h>"
+	print ""
+	print "#include \"mysql/mysql.h\""
+	print "#include \"postgresql/libpq-fe.h\""
+	print ""
+	print "typedef void step_fn(MYSQL *, PGconn *, char *, const char *);"
+	print ""
+	for (i = 0; i < n; i++)
+		printf "step_fn f%d;\n", i
+	print ""
+	printf "step_fn *next_fn[%d];\n", (n > 0 ? n : 1)
+
+	call = 0
+	source = 0
+	sink = 0
+	for (i = 0; i < n; i++) {
+		print ""
+		print "void"
+		printf "f%d(MYSQL *my, PGconn *pg, char *q, const char *arg)\n", i
+		print "{"
+		if (picked(i, sources, n)) {
+			if (source++ % 2 == 0)
+				printf "\tsprintf(q, \"SELECT c FROM t%d WHERE k = '"'"'%%s'"'"'\", arg);\n", i
+			else
+				printf "\tstrcpy(q, \"UPDATE t%d SET c = c + 1\");\n", i
+		}
+		if (picked(i, sinks, n)) {
+			if (sink++ % 2 == 0)
+				print "\tmysql_query(my, q);"
+			else
+				print "\tPQclear(PQexec(pg, q));"
+		}
+		if (has_next(i)) {
+			if (picked(call, indirect, calls)) {
+				printf "\tnext_fn[%d](my, pg, q, arg);\n", i
+				target[i] = i + 1
+			} else {
+				printf "\tf%d(my, pg, q, arg);\n", i + 1
+			}
+			call++
+		}
+		print "}"
+	}
+
+	print ""
+	print "int"
+	print "main(int argc, char *argv[])"
+	print "{"
+	print "\tMYSQL *my = mysql_init(NULL);"
+	print "\tPGconn *pg = PQconnectdb(\"\");"
+	print "\tconst char *arg = argc > 1 ? argv[1] : \"x\";"
+	print "\tchar q[256];"
+	print ""
+	print "\tq[0] = 0;"
+	for (i = 0; i < n; i++)
+		if (i in target)
+			printf "\tnext_fn[%d] = f%d;\n", i, target[i]
+	for (i = 0; i < n; i += depth)
+		printf "\tf%d(my, pg, q, arg);\n", i
+	print "\treturn 0;"
+	print "}"
+}'
@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# scale.sh BUILD_DIR CC "FUNCS DEPTH INDIRECT SOURCES SINKS"...
+#
+# Generates a program with gen_program.sh for every configuration, compiles
+# it with CC (normally $SS_CC) and prints one line per configuration: the
+# compile wall time, the wall time of the analysis phases as reported by
+# -sqlrand-stats-json, and the peak RSS of the compiler. "infoflow" is the
+# Infoflow constraint generation plus all the constraint solving; "sqlrand"
+# is the sum of the SQLRandPass phases, which includes most of the solving,
+# so the two overlap. Times are in milliseconds, memory in KB.
+
+BUILD=$1
+CC=$2
+shift 2
+
+# phase JSON NAME: wall time of phase NAME in ms, 0 if it is missing
+phase() {
+	echo "$1" | sed -n "s/.*\"$2\":{\"wall_s\":\([0-9.]*\).*/\1/p" |
+	    awk '{ ms = $1 * 1000 } END { printf "%.1f", ms }'
+}
+
+printf "%6s %5s %8s %7s %5s %10s %9s %9s %9s %9s %9s %10s\n" \
+	funcs depth indirect sources sinks compile dsa points-to infoflow \
+	solve sqlrand rss_kb
+for config in "$@"; do
+	set -- $config
+	name="scale_$1_$2_$3_$4_$5"
+	src="$BUILD/$name.c"
+	stats="$BUILD/$name.json"
+	./gen_program.sh "$@" > "$src" || exit 1
+	rm -f "$stats"
+
+	start=$(date +%s%N)
+	$CC $INCLUDES -mllvm -sqlrand-stats-json="$stats" \
+	    -c -o "$BUILD/$name.o" "$src" || exit 1
+	end=$(date +%s%N)
+
+	json=$(tail -n 1 "$stats")
+	constraints=$(phase "$json" constraints)
+	solve=$(phase "$json" solve)
+	sqlrand=0
+	for p in init sources sinks emit; do
+		sqlrand=$(awk -v a="$sqlrand" -v b="$(phase "$json" "sqlrand.$p")" \
+		    'BEGIN { printf "%.1f", a + b }')
+	done
+	rss=$(echo "$json" | sed -n 's/.*"peak_rss_kb":\([0-9]*\)}$/\1/p')
+
+	printf "%6d %5d %8d %7d %5d %10.1f %9s %9s %9.1f %9s %9s %10s\n" \
+	    "$1" "$2" "$3" "$4" "$5" "$(((end - start) / 1000000))" \
+	    "$(phase "$json" dsa)" "$(phase "$json" points-to)" \
+	    "$(awk -v a="$constraints" -v b="$solve" 'BEGIN { print a + b }')" \
+	    "$solve" "$sqlrand" "${rss:-0}"
+done
@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+# scale_check.sh BASELINE CURRENT TOLERANCE
+#
+# Compares two outputs of scale.sh line by line (configurations are matched
+# on their first five columns) and fails if the compile time or the peak RSS
+# of any configuration in CURRENT exceeds BASELINE by more than TOLERANCE
+# percent.
+
+BASELINE=$1
+CURRENT=$2
+TOLERANCE=$3
+
+test -f "$BASELINE" || {
+	echo "no baseline in $BASELINE, run make bench-scale-baseline first"
+	exit 1
+}
+
+awk -v tol="$TOLERANCE" '
+FNR == 1 { next }
+{ key = $1 " " $2 " " $3 " " $4 " " $5 }
+NR == FNR { compile[key] = $6; rss[key] = $12; next }
+!(key in compile) { next }
+{
+	checked++
+	if ($6 > compile[key] * (1 + tol / 100)) {
+		printf "%s: compile %.1f ms, baseline %.1f ms\n", key, $6, compile[key]
+		failed = 1
+	}
+	if ($12 > rss[key] * (1 + tol / 100)) {
+		printf "%s: peak RSS %d KB, baseline %d KB\n", key, $12, rss[key]
+		failed = 1
+	}
+}
+END {
+	if (!checked) {
+		print "no configuration of the baseline was measured"
+		exit 1
+	}
+	if (failed)
+		exit 1
+	printf "%d configurations within %d%% of the baseline\n", checked, tol
+}' "$BASELINE" "$CURRENT"
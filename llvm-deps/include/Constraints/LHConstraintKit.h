@@ -17,6 +17,7 @@
 
 #include "Constraints/ConstraintKit.h"
 #include "Constraints/LHConstraint.h"
+#include "PhaseTimer.h"
 
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/DenseSet.h"
@@ -68,6 +69,21 @@ public:
     void solveMT(std::string kind);
     // Solve the given kinds in parallel (per thread limit)
   std::vector<PartialSolution*> solveLeastMT(std::vector<std::string> kinds, bool useDefaultSinks);
+
+    /// Number of constraints added to each kind, after joins on the left
+    /// hand side are split. Kept when the constraints are freed.
+    const llvm::StringMap<uint64_t> &getConstraintCounts() const {
+      return constraintCounts;
+    }
+    /// Number of variables created by newVar
+    size_t getNumVars() const { return vars.size(); }
+    /// Number of least, greatest and multi-threaded least solutions
+    /// requested (the latter counted per kind)
+    unsigned getNumLeastSolves() const { return numLeastSolves; }
+    unsigned getNumGreatestSolves() const { return numGreatestSolves; }
+    unsigned getNumLeastMTSolves() const { return numLeastMTSolves; }
+    /// Time spent computing and merging solutions
+    const PhaseTime &getSolveTime() const { return solveTime; }
 private:
     static LHConstraintKit *singleton;
     llvm::StringMap<std::vector<LHConstraint> > constraints;
@@ -80,6 +96,12 @@ private:
     llvm::StringMap<PartialSolution*> leastSolutions;
     llvm::StringMap<PartialSolution*> greatestSolutions;
 
+    llvm::StringMap<uint64_t> constraintCounts;
+    unsigned numLeastSolves;
+    unsigned numGreatestSolves;
+    unsigned numLeastMTSolves;
+    PhaseTime solveTime;
+
     void freeUnneededConstraints(std::string kind);
 
     std::vector<LHConstraint> &getOrCreateConstraintSet(const std::string kind);
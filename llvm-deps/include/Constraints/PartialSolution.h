@@ -17,6 +17,7 @@
 #include "Constraints/ConstraintKit.h"
 #include "Constraints/LHConstraintKit.h"
 #include "Constraints/LHConstraints.h"
+#include "Constraints/Trace.h"
 
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/DenseMap.h"
@@ -35,6 +36,8 @@ public:
 
   // Constructor, constraints aren't stored
   PartialSolution(Constraints & C, bool initial) : initial(initial) {
+    TraceSpan Span("solver", "PartialSolution",
+                   initial ? "greatest" : "least");
     initialize(C);
     propagate();
   }
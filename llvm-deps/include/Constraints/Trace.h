@@ -0,0 +1,69 @@
+//===-- Trace.h - Chrome trace-event timeline -------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// With -deps-trace=<file>, TraceSpan records how long each scope took, on
+// which thread, as a "complete" event of the Chrome trace-event format. The
+// events are kept in memory and written to <file> when the process exits;
+// load it in chrome://tracing or Perfetto. Without the option a TraceSpan
+// costs a flag test.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+
+#include <string>
+
+namespace deps {
+
+/// True when -deps-trace was given.
+bool traceEnabled();
+
+/// Records the time between its construction and destruction as one event.
+/// Category and Name must be string literals; Detail, if any, is copied and
+/// shown as the "detail" argument of the event.
+class TraceSpan {
+public:
+  TraceSpan(const char *Category, const char *Name)
+    : Active(traceEnabled()) {
+    if (Active)
+      begin(Category, Name, llvm::StringRef());
+  }
+
+  TraceSpan(const char *Category, const char *Name, llvm::StringRef Detail)
+    : Active(traceEnabled()) {
+    if (Active)
+      begin(Category, Name, Detail);
+  }
+
+  ~TraceSpan() {
+    if (Active)
+      end();
+  }
+
+private:
+  bool Active;
+  const char *Category;
+  const char *Name;
+  std::string Detail;
+  uint64_t Start;
+
+  void begin(const char *Category, const char *Name, llvm::StringRef Detail);
+  void end();
+
+  TraceSpan(const TraceSpan &);
+  void operator=(const TraceSpan &);
+};
+
+}
+
+#endif /* TRACE_H_ */
@@ -237,6 +237,12 @@ class Infoflow :
       kit->solveMT(kind);
     }
     std::vector<InfoflowSolution*> solveLeastMT(std::vector<std::string> kinds, bool useDefaultSinks);
+
+    /// The constraint kit, for its statistics. NULL once memory is released.
+    const LHConstraintKit *getConstraintKit() const { return kit; }
+    /// Time PointsToInterface took, kept here because that pass may be
+    /// freed before Infoflow's clients run.
+    const PhaseTime &getPointsToTime() const { return pointsToTime; }
   private:
     virtual void doInitialization();
     virtual void doFinalization();
@@ -247,6 +253,7 @@ class Infoflow :
     LHConstraintKit *kit;
 
     PointsToInterface *pti;
+    PhaseTime pointsToTime;
     SourceSinkAnalysis *sourceSinkAnalysis;
     PDTCache* pdtx;
 
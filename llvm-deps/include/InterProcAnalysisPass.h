@@ -25,6 +25,8 @@
 #define INTERPROC_ANALYSIS_PASS_H
 
 #include "assistDS/DataStructureCallGraph.h"
+#include "PhaseTimer.h"
+#include "Constraints/Trace.h"
 
 #include "llvm/Pass.h"
 #include "llvm/Module.h"
@@ -201,6 +203,23 @@ public:
     }
   }
 
+  /// getFunctionDependencies - For each analyzed function, adds to deps the
+  /// functions whose analysis requested its results, in any context.
+  void getFunctionDependencies(
+      std::map<const Function *, std::set<const Function *> > &deps) const {
+    for (typename std::map<AUnitType, std::set<AUnitType> >::const_iterator
+             I = dependencies.begin(), E = dependencies.end(); I != E; ++I) {
+      std::set<const Function *> &requesters = deps[&I->first.function()];
+      for (typename std::set<AUnitType>::const_iterator
+               D = I->second.begin(), DE = I->second.end(); D != DE; ++D)
+        requesters.insert(&D->function());
+    }
+  }
+
+  /// getAnalysisTime - Time spent in runOnModule, i.e. analyzing every
+  /// unit of the module.
+  const deps::PhaseTime &getAnalysisTime() const { return analysisTime; }
+
   /// getAnalysisUsage - InterProcAnalysisPass requires and preserves the
   /// call graph. Derived methods must call this implementation.
   virtual void getAnalysisUsage(AnalysisUsage &Info) const {
@@ -211,10 +230,20 @@ public:
   /// runOnModule - the work queue "driver". Continues analyzing
   /// AnalysisUnits until there is no more work to be done.
   bool runOnModule(Module &M) {
+    deps::PhaseRegion Region(analysisTime);
+    deps::TraceSpan Span("interproc", getPassName());
     doInitialization();
 
     analyzedFunctions.clear();
 
+    // A client that already has the results for this module (SQLRand's
+    // analysis cache) marks it with !deps.skip-analysis.
+    if (M.getNamedMetadata("deps.skip-analysis")) {
+      DEBUG(errs() << "[DEPS] analysis skipped\n");
+      doFinalization();
+      return false;
+    }
+
     DEBUG(errs() << "[DEPS] runOnModule:\n");
 
     // Add the main function to the queue. If there isn't
@@ -254,6 +283,7 @@ private:
   std::map<AUnitType, std::set<AUnitType> > dependencies;
   const AUnitType *currentAnalysisUnit;
   std::set<const Function *> analyzedFunctions;
+  deps::PhaseTime analysisTime;
 
   /// Adds entry points to the module to the work queue.
   void addStartItemsToWorkQueue() {
@@ -312,6 +342,8 @@ private:
   /// If the result changes, adds the invalidated dependencies
   /// to the work queue.
   void processAnalysisUnit(const AUnitType unit) {
+    deps::TraceSpan Span("interproc", "processAnalysisUnit",
+                         unit.function().getName());
     currentAnalysisUnit = &unit;
     ARecordIterator rec = analysisRecords.find(unit);
     assert(rec != analysisRecords.end() && "No input!");
@@ -0,0 +1,80 @@
+//===-- PhaseTimer.h - Time and memory of analysis phases -------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares PhaseTime and PhaseRegion, which record how long a phase
+// of the analysis pipeline took and how large the process had grown when it
+// ended. They play the role of llvm::Timer and llvm::TimeRegion, but the
+// totals can be read back, so a client (SQLRand's -sqlrand-stats-json) can
+// report them in its own format.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef PHASETIMER_H_
+#define PHASETIMER_H_
+
+#include "llvm/Support/Timer.h"
+
+#include <sys/resource.h>
+
+namespace deps {
+
+/// Time and memory of one phase, accumulated over every PhaseRegion that
+/// measured it. Times are in seconds, the peak RSS in KB.
+struct PhaseTime {
+  double Wall;
+  double User;
+  double System;
+  /// Wall clock at the start of the first region and the end of the last
+  double Begin;
+  double End;
+  /// Peak RSS of the process when the last region ended
+  long PeakRSS;
+  unsigned Regions;
+
+  PhaseTime() : Wall(0), User(0), System(0), Begin(0), End(0), PeakRSS(0),
+                Regions(0) { }
+
+  static long currentPeakRSS() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+      return 0;
+    return usage.ru_maxrss;
+  }
+};
+
+/// Adds the time between its construction and destruction to a PhaseTime.
+class PhaseRegion {
+public:
+  explicit PhaseRegion(PhaseTime &P)
+    : P(P), Start(llvm::TimeRecord::getCurrentTime(true)) {
+    if (P.Regions == 0)
+      P.Begin = Start.getWallTime();
+  }
+
+  ~PhaseRegion() {
+    llvm::TimeRecord End = llvm::TimeRecord::getCurrentTime(false);
+    P.Wall += End.getWallTime() - Start.getWallTime();
+    P.User += End.getUserTime() - Start.getUserTime();
+    P.System += End.getSystemTime() - Start.getSystemTime();
+    P.End = End.getWallTime();
+    P.PeakRSS = PhaseTime::currentPeakRSS();
+    P.Regions++;
+  }
+
+private:
+  PhaseTime &P;
+  llvm::TimeRecord Start;
+
+  PhaseRegion(const PhaseRegion &);
+  PhaseRegion &operator=(const PhaseRegion &);
+};
+
+}
+
+#endif /* PHASETIMER_H_ */
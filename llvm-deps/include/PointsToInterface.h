@@ -17,6 +17,7 @@
 
 #include "dsa/DataStructure.h"
 #include "assistDS/DSNodeEquivs.h"
+#include "PhaseTimer.h"
 
 #include "llvm/Pass.h"
 #include "llvm/Value.h"
@@ -50,6 +51,8 @@ private:
 
   EquivalenceClasses<const DSNode *> MergedLeaders;
 
+  PhaseTime RunTime;
+
   const EquivalenceClasses<const DSNode *> *Classes;
   DSNodeEquivs *EquivsAnalysis;
 
@@ -64,6 +67,12 @@ public:
 
   virtual bool runOnModule(Module &M);
 
+  //
+  // Time spent in runOnModule. The DSA passes it requires have all run by
+  // the time it starts.
+  //
+  const PhaseTime &getRunTime() const { return RunTime; }
+
   virtual void getAnalysisUsage(AnalysisUsage &AU) const {
     AU.addRequiredTransitive<DSNodeEquivs>();
     AU.setPreservesAll();
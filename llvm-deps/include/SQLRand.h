@@ -38,13 +38,20 @@
 #include "llvm/Pass.h"
 #include "llvm/PassManager.h"
 #include "llvm/Module.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ValueHandle.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 
 #include "Infoflow.h"
+#include "PhaseTimer.h"
+#include "SQLRandCache.h"
+#include "SQLRandKeywords.h"
 
 #include <set>
+#include <vector>
 
 using namespace llvm;
 using namespace deps;
@@ -168,27 +175,141 @@ namespace  {
 
   const unsigned int MAX_CHAR = 100;
 
-  // Dictionary containing hashes of keywords
-  std::map<std::string, std::string> hashToKey;
-  std::map<std::string, std::string> keyToHash;
+  /* struct sqlrand_site flags, see sqlrand_helpers.h */
+  const unsigned int SQLRAND_SITE_CONST_QUERY = 0x1;
+
+  /* SQL dialects a module may talk to, one keyword mapping each */
+  enum SQLDialect {
+    DIALECT_MYSQL = 0,
+    DIALECT_PGSQL,
+    NUM_DIALECTS
+  };
+
+  // Dictionary containing hashes of keywords, per dialect
+  std::map<std::string, std::string> hashToKey[NUM_DIALECTS];
+  std::map<std::string, std::string> keyToHash[NUM_DIALECTS];
+  // The same mapping as a trie, used to rewrite literals
+  sqlrand::KeywordTrie keywordTries[NUM_DIALECTS];
+
+  /*
+   * What the pass does with the calls of one function, from the built-in
+   * summaries and the -sqlrand-spec file: a source taints the memory it
+   * writes, a sink executes the query in argument queryArg, and the
+   * payload of a bulk-load channel is never randomized. Only the sinks
+   * with a __sqlrand_ wrapper in the runtime are rewritten; for the others,
+   * wrappers of the application, only the literals reaching them are.
+   */
+  struct CallSpec {
+    bool source;
+    bool sink;
+    bool bulk;
+    CallTaintEntry taint;
+    CallTaintEntry payload;
+    unsigned queryArg;
+    int dialect;
+    bool wrapped;
+
+    CallSpec() : source(false), sink(false), bulk(false), queryArg(0),
+                 dialect(-1), wrapped(false) {
+      CallTaintEntry none = { 0, TAINTS_NOTHING, TAINTS_NOTHING,
+                              TAINTS_NOTHING };
+      taint = payload = none;
+    }
+  };
 
   class SQLRandPass : public ModulePass {
    public:
-    SQLRandPass() : ModulePass(ID) {}
+    SQLRandPass() : ModulePass(ID), callSpecs(NULL) {}
     static char ID;
     bool runOnModule(Module &M);
 
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.addRequired<Infoflow>();
+      AU.addRequired<PointsToInterface>();
       AU.setPreservesAll();
     }
 
    private:
     Infoflow* infoflow;
+    PointsToInterface *pti;
     uint64_t unique_id;
+    /* bitmask of the SQLDialects the module talks to */
+    unsigned sqlDialects;
+    /*
+     * Calls of interest in the module, collected by indexCallSites() in a
+     * single scan so that no later phase walks the whole module
+     */
+    struct CallSiteIndex {
+      /* calls to sources and sinks, see CallSpec */
+      std::vector<CallInst *> sources;
+      std::vector<CallInst *> sinks;
+      /* calls with literal arguments, in module order */
+      std::vector<WeakVH> literalCalls;
+      /* bulk-load data calls and LOCAL INFILE handler registrations */
+      std::vector<CallInst *> bulkCalls;
+      /* bitmask of the SQLDialects called */
+      unsigned dialects;
+    } callSites;
+
+    /* the CallSpec of every function with one, keyed by name */
+    const StringMap<CallSpec> *callSpecs;
+
+    /* backward solution of each sink, see getSinkSol() */
+    DenseMap<const CallInst *, InfoflowSolution *> sinkSols;
+
+    /* dialect each randomized literal was randomized for */
+    std::map<const GlobalVariable *, int> literalDialect;
+    /* initializer of each randomized literal before it was randomized */
+    std::map<const GlobalVariable *, std::string> literalPlaintext;
+    /* copies of a literal for the sinks of a second dialect */
+    std::map<std::pair<const GlobalVariable *, int>, GlobalVariable *>
+        dialectCopies;
+    /* plaintext copy of a literal sent by constant-query sites */
+    std::map<const GlobalVariable *, GlobalVariable *> plaintextTwins;
+    /* literals picked by sanitizeGlobal(), rewritten by rewriteLiterals() */
+    std::vector<GlobalVariable *> pendingLiterals;
+
+    /*
+     * A rewritten sink whose query is a constant randomized literal. Once
+     * the runtime has verified it, sets *verified and later executions call
+     * callee with the plaintext twin of the query directly.
+     */
+    struct ConstQuerySite {
+      CallInst *check;
+      Function *callee;
+      Constant *plaintext;
+      GlobalVariable *verified;
+    };
+    std::vector<ConstQuerySite> constQuerySites;
+
+    /*
+     * With -sqlrand-incremental: the structural hash of every function as
+     * it was before the rewrite, and the functions that have to be solved
+     * again. Everything outside dirtyFunctions is replayed.
+     */
+    bool incremental;
+    std::map<std::string, uint64_t> functionHashes;
+    std::set<const Function *> dirtyFunctions;
+
+    /* time of each phase of runOnModule, see -sqlrand-stats-json */
+    struct PhaseTimes {
+      deps::PhaseTime replay, init, sources, sinks, emit;
+    } phases;
+    /* sinks rewritten into their __sqlrand_ wrappers */
+    unsigned numRewritten;
+
+    /* literal payloads of bulk-load calls, left untouched */
+    std::set<const Value *> bulkPayloads;
+    /* globals initialized with tables or structs of string literals */
+    std::vector<GlobalVariable *> fragmentTables;
+    /* LOAD DATA LOCAL INFILE read callbacks */
+    std::set<const Function *> bulkFunctions;
 
     virtual int doInitialization(Module &M);
     virtual void doFinalization(Module &M);
+    void instrumentModule(Module &M);
+    void sanitizeSources(Module &M);
+    void writeStats(Module &M, double pipelineStart);
 
     InfoflowSolution *getForwardSolFromEntry(std::string s,
                                              CallInst *ci,
@@ -197,17 +318,23 @@ namespace  {
                                                CallInst *ci,
                                                const CallTaintEntry *entry);
     InfoflowSolution *getBackwardsSol(std::string s, CallInst *ci);
+    std::vector<InfoflowSolution *>
+        getForwardSolsFromSources(std::vector<CallInst *> &sources);
+    InfoflowSolution *getSinkSol(CallInst *ci);
+    void releaseSinkSols();
 
     InfoflowSolution *getForwardSolFromGlobal(std::string srcKind,
                                               Value *val);
 
     bool backwardSlicingBlacklisting(Module &M,
                                      InfoflowSolution* fsoln,
-                                     CallInst* srcCI);
+                                     CallInst* srcCI,
+                                     int &dialect);
 
     bool backwardsFromGlobal(Module &M,
                              InfoflowSolution* fsoln,
-                             Value *val);
+                             Value *val,
+                             int &dialect);
 
     void taintBackwards(std::string s,
                         CallInst *ci,
@@ -216,7 +343,9 @@ namespace  {
     void taintForward(std::string s,
                       CallInst *ci,
                       const CallTaintEntry *entry);
-    void sanitizeLiteralsBackwards(Module &M, InfoflowSolution *soln);
+    void sanitizeLiteralsBackwards(Module &M,
+                                   InfoflowSolution *soln,
+                                   int dialect);
 
     bool checkForwardTainted(Value &V,
                              InfoflowSolution* soln,
@@ -227,30 +356,64 @@ namespace  {
                               bool direct=true);
 
     bool isConstAssign(const std::set<const Value *> vMap);
-    bool isKeyword(std::string word);
     bool isLiteral(Value *operand);
+    bool isRandomized(Value *operand, int dialect);
     bool isVariable(Value *operand);
 
-    int getSQLType(Module &M);
+    unsigned getSQLType(Module &M);
+    const CallSpec *getCallSpec(StringRef name);
+    const CallSpec *getCallSpec(CallInst *ci);
+    void indexCallSites(Module &M);
+
+    void findBulkDataChannels(Module &M);
+    bool isBulkDataCall(Function *f);
+    bool feedsBulkData(Value *op);
 
     void randomizeSuffix();
     void dbg(std::string s);
     void dbgMsg(std::string s, std::string b);
-    void hashSQLKeywords(bool isMySQL);
-
-    Value *sanitizeArgOp(Module &M, Value *op);
+    void hashSQLKeywords(int dialect);
+
+    Value *sanitizeArgOp(Module &M, Value *op, int dialect);
+    GlobalVariable *getDialectCopy(Module &M, GlobalVariable *gv,
+                                   int dialect);
+    void sanitizeGlobal(Module &M, GlobalVariable *gv, int dialect);
+    void sanitizeAggregate(Module &M, GlobalVariable *gv,
+                           InfoflowSolution *fsoln);
+    void getInitializerStrings(GlobalVariable *gv,
+                               std::vector<GlobalVariable *> &strings);
+    void collectInitializerStrings(Constant *C,
+                                   std::set<const GlobalVariable *> &visited,
+                                   std::vector<GlobalVariable *> &strings);
+
+    bool loadFunctionState(Module &M);
+    bool getAccessedLocations(const Function *F, AbstractLocSet &locs);
+    void saveFunctionState(Module &M);
+    bool isDirty(const Function *F);
+    bool usedInDirtyFunction(const Value *V);
+
+    void saveCacheEntry(Module &M, const std::string &key);
+    void replayCacheEntry(Module &M, const sqlrand::CacheEntry &entry);
     std::string pad(std::string word, std::string suffix);
     std::string getKindId(std::string name, uint64_t *unique_id);
-    std::string sanitizeString(std::string input);
+    static std::string sanitizeString(const std::string &input, int dialect);
+    static void *sanitizeWorker(void *arg);
+    void rewriteLiterals(Module &M);
     std::string hashString(std::string input);
 
     std::string &rtrim(std::string &s);
     std::string &ltrim(std::string &s);
 
-    void insertSQLCheckFunction(Module &M,
-                                std::string name,
-                                CallInst *ci,
-                                BasicBlock::iterator ii);
+    void emitMapping(Module &M);
+    bool linkRuntime(Module &M);
+
+    Constant *getPlaintextQuery(Module &M, Value *query);
+    Constant *getSiteDescriptor(Module &M, CallInst *ci,
+                                GlobalVariable *verified);
+    void emitConstQueryChecks(Module &M);
+    CallInst *insertSQLCheckFunction(Module &M,
+                                     std::string name,
+                                     CallInst *ci);
 
   };	/* ------------------  Class End ------------------ */
 
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SQLRAND_CACHE_H__
+#define __SQLRAND_CACHE_H__
+
+#include "llvm/Pass.h"
+#include "llvm/Function.h"
+#include "llvm/Module.h"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace llvm;
+
+/*
+ * Bump whenever the pass changes which literals or sinks it rewrites, so
+ * that entries written by an older pass are never replayed.
+ */
+#define SQLRAND_CACHE_VERSION 3
+
+/*
+ * Named metadata shared by the cache pass and SQLRandPass. The key is the
+ * one computed before any analysis ran; the skip marker is honoured by
+ * InterProcAnalysisPass (and so by Infoflow) when the cache hit.
+ */
+#define SQLRAND_CACHE_KEY_MD	"sqlrand.cache-key"
+#define DEPS_SKIP_ANALYSIS_MD	"deps.skip-analysis"
+
+namespace sqlrand {
+
+/*
+ * Operand @operand of instruction @inst of function @function, a literal
+ * that was copied for the sinks of its second dialect @dialect.
+ */
+struct CopyUse {
+  int dialect;
+  unsigned function;
+  unsigned inst;
+  unsigned operand;
+};
+
+/*
+ * What SQLRandPass decided for one module. Everything is identified by
+ * position, which is stable because the entry is only used for a module
+ * with exactly the same bitcode.
+ */
+struct CacheEntry {
+  /* bitmask of the dialects the module talks to */
+  unsigned dialects;
+  /* (dialect, index among the module's globals) of each literal */
+  std::vector<std::pair<int, unsigned> > literals;
+  /* (index of the function, index of the instruction in it) of each sink */
+  std::vector<std::pair<unsigned, unsigned> > sinks;
+  /* uses of a literal that reaches sinks of both dialects */
+  std::vector<CopyUse> copies;
+
+  CacheEntry() : dialects(0) {}
+};
+
+bool cacheEnabled();
+std::string getModuleKey(const Module &M);
+bool readCacheEntry(const std::string &key, CacheEntry &entry);
+bool writeCacheEntry(const std::string &key, const CacheEntry &entry);
+
+/*
+ * A literal use randomized by an earlier build: operand @operand of
+ * instruction @inst of function @function. Only replayed while the
+ * function's structural hash is unchanged, so the position stays valid.
+ */
+struct LiteralUse {
+  std::string function;
+  unsigned inst;
+  unsigned operand;
+  int dialect;
+};
+
+/*
+ * Per-function state of a module, kept between builds with
+ * -sqlrand-incremental.
+ */
+struct FunctionState {
+  /* structural hash of every function defined in the module */
+  std::map<std::string, uint64_t> hashes;
+  std::vector<LiteralUse> literals;
+};
+
+bool incrementalEnabled();
+uint64_t getFunctionHash(const Function &F);
+bool readFunctionState(const Module &M, FunctionState &state);
+bool writeFunctionState(const Module &M, const FunctionState &state);
+
+std::string getCacheKeyFromModule(const Module &M);
+void clearCacheMarkers(Module &M);
+
+/*
+ * Runs ahead of the analyses. Computes the key of the untouched module
+ * and, if an entry exists for it, marks the module so that Infoflow skips
+ * constraint generation and SQLRandPass only replays the rewrite.
+ */
+class SQLRandCachePass : public ModulePass {
+ public:
+  static char ID;
+  SQLRandCachePass() : ModulePass(ID) {}
+  bool runOnModule(Module &M);
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.setPreservesAll();
+  }
+};
+
+} /* ------------------  namespace end ------------------ */
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SQLRAND_KEYWORDS_H__
+#define __SQLRAND_KEYWORDS_H__
+
+#include "llvm/ADT/StringRef.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace sqlrand {
+
+/*
+ * Case-insensitive trie over the keywords of one SQL dialect, mapping each
+ * keyword to its randomized replacement. A token is looked up with one step
+ * per character, without being copied or uppercased first.
+ */
+class KeywordTrie {
+ public:
+  KeywordTrie();
+
+  bool empty() const { return replacements.empty(); }
+  void insert(StringRef keyword, StringRef replacement);
+
+  /* The replacement of @token if it is a keyword, NULL otherwise */
+  const std::string *lookup(const char *token, size_t len) const;
+
+ private:
+  /* A-Z (either case), 0-9 and '_', the characters of every keyword */
+  enum { ALPHABET = 37 };
+
+  struct Node {
+    uint32_t child[ALPHABET];
+    int32_t replacement;
+  };
+
+  std::vector<Node> nodes;
+  std::vector<std::string> replacements;
+
+  static int index(unsigned char c);
+  uint32_t addNode();
+};
+
+} /* ------------------  namespace end ------------------ */
+#endif
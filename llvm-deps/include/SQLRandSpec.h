@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SQLRAND_SPEC_H__
+#define __SQLRAND_SPEC_H__
+
+#include <string>
+#include <vector>
+
+/*
+ * Additional sources, sinks and bulk-load channels, read from the file
+ * given with -sqlrand-spec. Every non-empty line that does not start with
+ * '#' is one of
+ *
+ *   source <function> <arguments>
+ *   sink   <function> <argument> <mysql|pgsql>
+ *   bulk   <function> <arguments>
+ *
+ * Arguments are numbered from 1 and separated by commas. A source taints
+ * the memory its arguments point to, and its return value if "ret" is
+ * listed. A sink executes the query in its argument, e.g. a wrapper or ORM
+ * function of the application. A bulk channel sends its arguments to the
+ * server as row data, so literals passed there are never randomized.
+ */
+
+namespace sqlrand {
+
+struct SpecEntry {
+  enum Role { SOURCE, SINK, BULK };
+
+  Role role;
+  std::string function;
+  /* indices of the arguments, from 0 */
+  std::vector<unsigned> args;
+  bool taintsReturn;
+  /* "mysql" or "pgsql", sinks only */
+  std::string dialect;
+
+  SpecEntry() : role(SOURCE), taintsReturn(false) {}
+};
+
+bool specEnabled();
+/* Read once per process; a malformed file is a fatal error */
+const std::vector<SpecEntry> &getSpecEntries();
+/* The contents of the file, part of the analysis cache key */
+const std::string &getSpecText();
+
+} /* ------------------  namespace end ------------------ */
+#endif
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SQLRAND_STATS_H__
+#define __SQLRAND_STATS_H__
+
+#include "llvm/Module.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <stdint.h>
+#include <string>
+
+#include "PhaseTimer.h"
+
+using namespace llvm;
+
+/*
+ * Named metadata holding the wall-clock time at which SQLRandCachePass,
+ * the first pass of the pipeline, finished. Everything between it and
+ * PointsToInterface is DSA.
+ */
+#define SQLRAND_STATS_START_MD	"sqlrand.stats-start"
+
+namespace sqlrand {
+
+bool statsEnabled();
+void markPipelineStart(Module &M);
+double takePipelineStart(Module &M);
+bool appendStatsRecord(const std::string &json);
+
+/*
+ * Builds one JSON object, member by member
+ */
+class JSONObject {
+ public:
+  JSONObject() : first(true) {}
+
+  void add(StringRef key, double value);
+  void add(StringRef key, uint64_t value);
+  void add(StringRef key, StringRef value);
+  void add(StringRef key, const JSONObject &value);
+  void add(StringRef key, const deps::PhaseTime &phase);
+
+  std::string str() const { return "{" + body + "}"; }
+
+ private:
+  std::string body;
+  bool first;
+
+  void addKey(StringRef key);
+};
+
+std::string quoteJSON(StringRef s);
+
+} /* ------------------  namespace end ------------------ */
+#endif
@@ -26,7 +26,8 @@ namespace deps {
 STATISTIC(explicitLHConstraints, "Number of explicit flow constraints");
 STATISTIC(implicitLHConstraints, "Number of implicit flow constraints");
 
-LHConstraintKit::LHConstraintKit() {}
+LHConstraintKit::LHConstraintKit()
+  : numLeastSolves(0), numGreatestSolves(0), numLeastMTSolves(0) {}
 
 LHConstraintKit::~LHConstraintKit() {
     // Delete all associated LHConsVars
@@ -96,6 +97,7 @@ void LHConstraintKit::addConstraint(const std::string kind,
     if (kind == "implicit") implicitLHConstraints++;
 
     std::vector<LHConstraint> &set = getOrCreateConstraintSet(kind);
+    size_t before = set.size();
 
     assert(!llvm::isa<LHJoin>(&rhs) && "We shouldn't have joins on rhs!");
 
@@ -110,9 +112,13 @@ void LHConstraintKit::addConstraint(const std::string kind,
         LHConstraint c(lhs, rhs);
         set.push_back(c);
     }
+
+    constraintCounts[kind] += set.size() - before;
 }
 
 ConsSoln *LHConstraintKit::leastSolution(const std::set<std::string> kinds) {
+  PhaseRegion Region(solveTime);
+  numLeastSolves++;
   PartialSolution *PS = NULL;
   for (std::set<std::string>::iterator kind = kinds.begin(), end = kinds.end(); kind != end; ++kind) {
     if (!leastSolutions.count(*kind)) {
@@ -130,6 +136,8 @@ ConsSoln *LHConstraintKit::leastSolution(const std::set<std::string> kinds) {
 }
 
 ConsSoln *LHConstraintKit::greatestSolution(const std::set<std::string> kinds) {
+  PhaseRegion Region(solveTime);
+  numGreatestSolves++;
   PartialSolution *PS = NULL;
   for (std::set<std::string>::iterator kind = kinds.begin(), end = kinds.end(); kind != end; ++kind) {
     if (!greatestSolutions.count(*kind)) {
@@ -16,8 +16,10 @@
 
 namespace deps {
 
-LHConstant *LHConstant::lowSingleton = NULL;
-LHConstant *LHConstant::highSingleton = NULL;
+// Created when the library is loaded, before any pass can run on another
+// thread: the lattice constants are compared by address.
+LHConstant *LHConstant::lowSingleton = new LHConstant(LOW);
+LHConstant *LHConstant::highSingleton = new LHConstant(HIGH);
 
 LHConstant::LHConstant(LHLevel level) : level(level) { }
 
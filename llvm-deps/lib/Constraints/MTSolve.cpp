@@ -16,6 +16,7 @@
 #include "Constraints/LHConstraints.h"
 #include "Constraints/PartialSolution.h"
 #include "Constraints/SolverThread.h"
+#include "Constraints/Trace.h"
 
 #include "llvm/Support/Threading.h"
 #include "llvm/Support/Atomic.h"
@@ -38,6 +39,8 @@ SolverThread* SolverThread::spawn(Constraints &C, bool greatest) {
 void* SolverThread::solve(void* arg) {
   assert(arg);
   SolverThread *T = (SolverThread*)arg;
+  TraceSpan Span("solver", "solver thread",
+                 T->greatest ? "greatest" : "least");
   PartialSolution *P = new PartialSolution(T->C, T->greatest);
   return (void*)P;
 }
@@ -47,6 +50,9 @@ void SolverThread::join(PartialSolution*& P) {
 }
 
 void LHConstraintKit::solveMT(std::string kind) {
+  PhaseRegion Region(solveTime);
+  numLeastSolves++;
+  numGreatestSolves++;
   assert(lockedConstraintKinds.insert(kind).second && "Already solved");
   assert(!leastSolutions.count(kind));
   assert(!greatestSolutions.count(kind));
@@ -82,6 +88,7 @@ struct MergeInfo {
 
 void* merge(void *arg) {
   MergeInfo *MI = (MergeInfo*)arg;
+  TraceSpan Span("solver", "merge thread");
   for (std::vector<PartialSolution*>::iterator I = MI->Mergees.begin(),
 	 E = MI->Mergees.end(); I != E; ++I) {
     (*I)->mergeIn(*MI->Default);
@@ -94,6 +101,8 @@ void* merge(void *arg) {
 
 std::vector<PartialSolution*>
 LHConstraintKit::solveLeastMT(std::vector<std::string> kinds, bool useDefaultSinks) {
+  PhaseRegion Region(solveTime);
+  numLeastMTSolves += kinds.size();
   assert(leastSolutions.count("default"));
 
   PartialSolution *P = leastSolutions["default"];
@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "Constraints/PartialSolution.h"
+#include "Constraints/Trace.h"
 
 #include "llvm/Support/Casting.h"
 
@@ -64,6 +65,7 @@ const LHConstant& PartialSolution::subst(const ConsElem& E) {
 
 // Copy constructor
 PartialSolution::PartialSolution(PartialSolution &P) {
+  TraceSpan Span("solver", "PartialSolution copy");
   initial = P.initial;
 
   // Chain to it
@@ -78,6 +80,7 @@ PartialSolution::PartialSolution(PartialSolution &P) {
 
 // Merging constructor
 void PartialSolution::mergeIn(PartialSolution &P) {
+  TraceSpan Span("solver", "mergeIn");
   // Sanity check
   assert(initial == P.initial);
 
@@ -0,0 +1,157 @@
+//===-- Trace.cpp -----------------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Records TraceSpans and writes them out as Chrome trace-event JSON.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Constraints/Trace.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<std::string>
+TraceFile("deps-trace",
+          cl::desc("Write a Chrome trace-event timeline of the analysis to "
+                   "<file> (%p is replaced by the process id)"),
+          cl::value_desc("file"), cl::init(""));
+
+namespace {
+
+struct TraceEvent {
+  const char *Category;
+  const char *Name;
+  std::string Detail;
+  uint64_t Start;
+  uint64_t Duration;
+  long Thread;
+};
+
+/// All events of the process, written out when it exits. The solver threads
+/// are plain pthreads, so the lock must not depend on llvm_is_multithreaded().
+class TraceLog {
+public:
+  ~TraceLog() { write(); }
+
+  void add(const TraceEvent &E) {
+    sys::ScopedLock Guard(Lock);
+    Events.push_back(E);
+  }
+
+private:
+  sys::Mutex Lock;
+  std::vector<TraceEvent> Events;
+
+  void write();
+};
+
+}
+
+// Defined after TraceFile so it is destroyed, and written, first.
+static TraceLog Log;
+
+static uint64_t nowMicros() {
+  struct timespec TS;
+  clock_gettime(CLOCK_MONOTONIC, &TS);
+  return (uint64_t)TS.tv_sec * 1000000 + TS.tv_nsec / 1000;
+}
+
+static void writeQuoted(raw_ostream &OS, StringRef S) {
+  OS << '"';
+  for (StringRef::iterator I = S.begin(), E = S.end(); I != E; ++I) {
+    unsigned char C = *I;
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (C < 0x20)
+      OS << format("\\u%04x", C);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+
+void TraceLog::write() {
+  if (TraceFile.empty() || Events.empty())
+    return;
+
+  std::string Path;
+  StringRef Pattern(TraceFile);
+  for (size_t i = 0; i < Pattern.size(); ++i) {
+    if (Pattern[i] == '%' && i + 1 < Pattern.size() && Pattern[i + 1] == 'p') {
+      raw_string_ostream(Path) << getpid();
+      ++i;
+    } else {
+      Path += Pattern[i];
+    }
+  }
+
+  std::string Error;
+  raw_fd_ostream OS(Path.c_str(), Error);
+  if (!Error.empty()) {
+    errs() << "deps-trace: cannot write " << Path << ": " << Error << "\n";
+    return;
+  }
+
+  int Pid = getpid();
+  OS << "{\"traceEvents\":[\n";
+  for (std::vector<TraceEvent>::const_iterator I = Events.begin(),
+       E = Events.end(); I != E; ++I) {
+    if (I != Events.begin())
+      OS << ",\n";
+    OS << "{\"ph\":\"X\",\"cat\":";
+    writeQuoted(OS, I->Category);
+    OS << ",\"name\":";
+    writeQuoted(OS, I->Name);
+    OS << ",\"pid\":" << Pid << ",\"tid\":" << I->Thread
+       << ",\"ts\":" << I->Start << ",\"dur\":" << I->Duration;
+    if (!I->Detail.empty()) {
+      OS << ",\"args\":{\"detail\":";
+      writeQuoted(OS, I->Detail);
+      OS << "}";
+    }
+    OS << "}";
+  }
+  OS << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+namespace deps {
+
+bool traceEnabled() {
+  return !TraceFile.empty();
+}
+
+void TraceSpan::begin(const char *Category, const char *Name,
+                      StringRef Detail) {
+  this->Category = Category;
+  this->Name = Name;
+  this->Detail = Detail;
+  Start = nowMicros();
+}
+
+void TraceSpan::end() {
+  TraceEvent E;
+  E.Category = Category;
+  E.Name = Name;
+  E.Detail.swap(Detail);
+  E.Start = Start;
+  E.Duration = nowMicros() - Start;
+  E.Thread = syscall(SYS_gettid);
+  Log.add(E);
+}
+
+}
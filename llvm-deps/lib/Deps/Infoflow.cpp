@@ -58,6 +58,7 @@ void
 Infoflow::doInitialization() {
   // Get the PointsToInterface
   pti = &getAnalysis<PointsToInterface>();
+  pointsToTime = pti->getRunTime();
   sourceSinkAnalysis = &getAnalysis<SourceSinkAnalysis>();
 
   signatureRegistrar = new SignatureRegistrar();
@@ -63,6 +63,7 @@ void PointsToInterface::mergeAllIncomplete() {
 }
 
 bool PointsToInterface::runOnModule(Module &M) {
+  PhaseRegion Region(RunTime);
   EquivsAnalysis = &getAnalysis<DSNodeEquivs>();
   Classes = &EquivsAnalysis->getEquivalenceClasses();
   mergeAllIncomplete();
@@ -30,7 +30,10 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define DEBUG_TYPE "sqlrand"
+
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
 #include <cctype>
 #include <fstream>
 #include <sstream>
@@ -38,30 +41,85 @@
 #include <iostream>
 #include <iterator>
 #include <vector>
+#include <pthread.h>
+#include <unistd.h>
 
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/DebugInfo.h"
 #include "llvm/Instruction.h"
 #include "llvm/Instructions.h"
 #include "llvm/LLVMContext.h"
 #include "llvm/Function.h"
+#include "llvm/Linker.h"
 #include "llvm/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Support/IRReader.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ValueHandle.h"
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
 
 #include "llvm/IRBuilder.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 
 #include "Infoflow.h"
+#include "Constraints/Trace.h"
 #include "Slice.h"
 
 #include "SQLRand.h"
+#include "SQLRandCache.h"
+#include "SQLRandSpec.h"
+#include "SQLRandStats.h"
 
 using std::set;
 using namespace llvm;
 using namespace deps;
 
+STATISTIC(NumBackwardSolves, "Number of backward solutions computed for sinks");
+STATISTIC(NumBackwardReuses, "Number of backward solutions reused from cache");
+STATISTIC(NumDirtyFunctions, "Number of functions solved again incrementally");
+STATISTIC(NumReplayedLiterals, "Number of literal uses replayed incrementally");
+STATISTIC(NumIncrementalFallbacks,
+          "Number of incremental builds that solved the whole module");
+STATISTIC(NumAggregateLiterals, "Number of literals randomized in aggregates");
+STATISTIC(NumConstQueryChecks, "Number of constant-query sinks checked inline");
+
 namespace {
+
+static cl::opt<std::string> SQLRandRuntimeBC(
+  "sqlrand-runtime-bc",
+  cl::desc("Link the SQLRand runtime bitcode into the module so the checks "
+           "can be inlined at the call sites"),
+  cl::value_desc("bitcode file"), cl::init(""));
+
+static cl::opt<std::string> SQLRandMapping(
+  "sqlrand-mapping",
+  cl::desc("Prefix of the keyword mapping files shared by the modules of one "
+           "build; _mysql / _pgsql is appended (default: /tmp/.sqlrand)"),
+  cl::value_desc("prefix"), cl::init(""));
+
+static cl::opt<unsigned> SQLRandThreads(
+  "sqlrand-threads",
+  cl::desc("Number of threads that randomize the string literals of a "
+           "module (default: online CPUs)"),
+  cl::init(0));
+
+static cl::opt<bool> SQLRandConstQueryCheck(
+  "sqlrand-const-query-check",
+  cl::desc("Let sinks of constant queries skip the runtime once their query "
+           "has been verified, sending a plaintext copy built at compile "
+           "time"),
+  cl::init(true));
+
 //FIXME need to handle constant assignments as well!
 //What about environment variables?
 static const struct CallTaintEntry bLstSourceSummaries[] = {
@@ -88,24 +146,133 @@ static const struct CallTaintEntry sanitizeSummaries[] = {
   { 0,          		TAINTS_NOTHING,		TAINTS_NOTHING,		TAINTS_NOTHING }
 };
 
+/*
+ * Bulk-load data channels. The COPY / LOAD DATA command itself goes through
+ * one of the sinks above and is checked as usual; the payload is row data
+ * that must reach the server untouched, so it is never randomized.
+ */
+static const struct CallTaintEntry bulkDataSummaries[] = {
+  // function,  	tainted values,   tainted direct memory, tainted root ptrs
+  { "PQputCopyData",    TAINTS_ARG_2,  	TAINTS_ARG_2,    	TAINTS_NOTHING },
+  { "PQputCopyEnd",     TAINTS_ARG_2,  	TAINTS_ARG_2,    	TAINTS_NOTHING },
+  { 0,          		TAINTS_NOTHING,		TAINTS_NOTHING,		TAINTS_NOTHING }
+};
+
+/* Dialect a sink talks to, -1 if @name is not a sink */
+static int
+getSinkDialect(StringRef name)
+{
+  if (name.startswith("mysql_"))
+    return DIALECT_MYSQL;
+  if (name.startswith("PQ"))
+    return DIALECT_PGSQL;
+  return -1;
+}
+
+static const char *
+getDialectName(int dialect)
+{
+  return dialect == DIALECT_MYSQL ? "mysql" : "pgsql";
+}
+
+/* mysql_set_local_infile_handler(mysql, init, read, end, error, userdata) */
+static const char *LOCAL_INFILE_HANDLER = "mysql_set_local_infile_handler";
+static const unsigned LOCAL_INFILE_READ_ARG = 2;
+
 
 /* ****************************************************************************
  * ============================================================================
  *  						Taint Functions
  * ============================================================================
  * ****************************************************************************/
-static const CallTaintEntry *
-findEntryForFunction(const CallTaintEntry *Summaries,
-                     const std::string &FuncName) {
-  unsigned Index;
+/*
+ * The CallSpec of every source, sink and bulk-load channel: the summaries
+ * above, then the entries of the -sqlrand-spec file. Built once per
+ * process, under the lock, and only read afterwards.
+ */
+static ManagedStatic<sys::SmartMutex<true> > CallSpecsLock;
+static ManagedStatic<StringMap<CallSpec> > CallSpecs;
 
-  for (Index = 0; Summaries[Index].Name; ++Index) {
-    if (Summaries[Index].Name == FuncName)
-      return &Summaries[Index];
+static void
+addTaintEntries(StringMap<CallSpec> &specs, const CallTaintEntry *summaries,
+                bool CallSpec::*role, CallTaintEntry CallSpec::*taint)
+{
+  for (const CallTaintEntry *e = summaries; e->Name; ++e) {
+    CallSpec &spec = specs[e->Name];
+    spec.*role = true;
+    spec.*taint = *e;
   }
+}
+
+static void
+addSpecEntry(StringMap<CallSpec> &specs, const sqlrand::SpecEntry &entry)
+{
+  CallSpec &spec = specs[entry.function];
+
+  switch (entry.role) {
+  case sqlrand::SpecEntry::SOURCE:
+    spec.source = true;
+    spec.taint.ValueSummary.TaintsReturnValue = entry.taintsReturn;
+    for (size_t i = 0; i < entry.args.size(); i++)
+      spec.taint.DirectPointerSummary.TaintsArgument[entry.args[i]] = true;
+    break;
+  case sqlrand::SpecEntry::SINK:
+    spec.sink = true;
+    spec.queryArg = entry.args[0];
+    spec.dialect = entry.dialect == getDialectName(DIALECT_MYSQL) ?
+        DIALECT_MYSQL : DIALECT_PGSQL;
+    break;
+  case sqlrand::SpecEntry::BULK:
+    spec.bulk = true;
+    for (size_t i = 0; i < entry.args.size(); i++) {
+      spec.payload.ValueSummary.TaintsArgument[entry.args[i]] = true;
+      spec.payload.DirectPointerSummary.TaintsArgument[entry.args[i]] = true;
+    }
+    break;
+  }
+}
+
+static const StringMap<CallSpec> &
+getCallSpecs()
+{
+  sys::SmartScopedLock<true> Guard(*CallSpecsLock);
+  StringMap<CallSpec> &specs = *CallSpecs;
+  if (!specs.empty())
+    return specs;
+
+  addTaintEntries(specs, bLstSourceSummaries,
+                  &CallSpec::source, &CallSpec::taint);
+  addTaintEntries(specs, bulkDataSummaries,
+                  &CallSpec::bulk, &CallSpec::payload);
+
+  /* the runtime wraps these; the query is always the second argument */
+  for (const CallTaintEntry *e = sanitizeSummaries; e->Name; ++e) {
+    CallSpec &spec = specs[e->Name];
+    spec.sink = true;
+    spec.queryArg = 1;
+    spec.dialect = getSinkDialect(e->Name);
+    spec.wrapped = true;
+  }
+
+  const std::vector<sqlrand::SpecEntry> &entries = sqlrand::getSpecEntries();
+  for (size_t i = 0; i < entries.size(); i++)
+    addSpecEntry(specs, entries[i]);
 
-  // Return the default summary.
-  return &Summaries[Index];
+  return specs;
+}
+
+const CallSpec *
+SQLRandPass::getCallSpec(StringRef name)
+{
+  StringMap<CallSpec>::const_iterator it = callSpecs->find(name);
+  return it == callSpecs->end() ? NULL : &it->getValue();
+}
+
+const CallSpec *
+SQLRandPass::getCallSpec(CallInst *ci)
+{
+  Function *f = ci->getCalledFunction();
+  return f == NULL ? NULL : getCallSpec(f->getName());
 }
 
 void
@@ -117,12 +284,15 @@ SQLRandPass::taintForward(std::string srcKind,
   const CallTaintSummary *dSum = &(entry->DirectPointerSummary);
   const CallTaintSummary *rSum = &(entry->RootPointerSummary);
 
+  /* entries of -sqlrand-spec may name arguments a call does not have */
+  unsigned NumArgs = ci->getNumArgOperands();
+
   /* vsum */
   if (vSum->TaintsReturnValue)
     infoflow->setTainted(srcKind, *ci);
 
   for (unsigned ArgIndex = 0; ArgIndex < vSum->NumArguments; ++ArgIndex) {
-    if (vSum->TaintsArgument[ArgIndex])
+    if (vSum->TaintsArgument[ArgIndex] && ArgIndex < NumArgs)
       infoflow->setTainted(srcKind, *(ci->getOperand(ArgIndex)));
   }
 
@@ -131,7 +301,7 @@ SQLRandPass::taintForward(std::string srcKind,
     infoflow->setDirectPtrTainted(srcKind, *ci);
 
   for (unsigned ArgIndex = 0; ArgIndex < dSum->NumArguments; ++ArgIndex) {
-    if (dSum->TaintsArgument[ArgIndex])
+    if (dSum->TaintsArgument[ArgIndex] && ArgIndex < NumArgs)
       infoflow->setDirectPtrTainted(srcKind, *(ci->getOperand(ArgIndex)));
   }
 
@@ -140,7 +310,7 @@ SQLRandPass::taintForward(std::string srcKind,
     infoflow->setReachPtrTainted(srcKind, *ci);
 
   for (unsigned ArgIndex = 0; ArgIndex < rSum->NumArguments; ++ArgIndex) {
-    if (rSum->TaintsArgument[ArgIndex])
+    if (rSum->TaintsArgument[ArgIndex] && ArgIndex < NumArgs)
       infoflow->setReachPtrTainted(srcKind, *(ci->getOperand(ArgIndex)));
   }
 }
@@ -230,6 +400,57 @@ SQLRandPass::getForwardSolFromEntry(std::string srcKind,
   return fsoln;
 }
 
+/*
+ * Forward solutions of all source calls and of all tables of query
+ * fragments, solved as one batch: the taint of every source and table is
+ * registered under its own kind first, then Infoflow::solveLeastMT merges
+ * the default solution into all of them in parallel. @sources receives the
+ * calls, in the order of the returned solutions, followed by one solution
+ * per entry of fragmentTables. The caller owns the solutions.
+ */
+std::vector<InfoflowSolution *>
+SQLRandPass::getForwardSolsFromSources(std::vector<CallInst *> &sources)
+{
+  std::vector<std::string> kinds;
+
+  for (std::vector<CallInst *>::iterator it = callSites.sources.begin();
+       it != callSites.sources.end();
+       ++it) {
+    CallInst *ci = *it;
+
+    /* Row data read for LOAD DATA LOCAL INFILE is not SQL */
+    if (bulkFunctions.count(ci->getParent()->getParent()))
+      continue;
+
+    /* its literals were replayed */
+    if (!isDirty(ci->getParent()->getParent()))
+      continue;
+
+    const CallTaintEntry *entry = &getCallSpec(ci)->taint;
+    std::string srcKind = getKindId("src", &unique_id);
+    taintForward(srcKind, ci, entry);
+
+    sources.push_back(ci);
+    kinds.push_back(srcKind);
+  }
+
+  /* a fragment is used by loading it from the table */
+  for (size_t i = 0; i < fragmentTables.size(); i++) {
+    std::string aggKind = getKindId("agg", &unique_id);
+    infoflow->setTainted(aggKind, *fragmentTables[i]);
+    infoflow->setDirectPtrTainted(aggKind, *fragmentTables[i]);
+    kinds.push_back(aggKind);
+  }
+
+  if (kinds.empty())
+    return std::vector<InfoflowSolution *>();
+
+  /* solveLeastMT merges into the default solutions, make sure they exist */
+  delete infoflow->leastSolution(std::set<std::string>(), false, true);
+
+  return infoflow->solveLeastMT(kinds, true);
+}
+
 InfoflowSolution *
 SQLRandPass::getBackwardsSol(std::string sinkKind, CallInst *ci)
 {
@@ -245,6 +466,39 @@ SQLRandPass::getBackwardsSol(std::string sinkKind, CallInst *ci)
   return fsoln;
 }
 
+/*
+ * Backward solution of sink @ci. It only depends on the sink, so it is
+ * computed once and shared by every source that reaches @ci and by
+ * doFinalization.
+ */
+InfoflowSolution *
+SQLRandPass::getSinkSol(CallInst *ci)
+{
+  DenseMap<const CallInst *, InfoflowSolution *>::iterator it =
+      sinkSols.find(ci);
+  if (it != sinkSols.end()) {
+    ++NumBackwardReuses;
+    return it->second;
+  }
+
+  ++NumBackwardSolves;
+  std::string sinkKind = getKindId("sql", &unique_id);
+  InfoflowSolution *soln = getBackwardsSol(sinkKind, ci);
+  sinkSols[ci] = soln;
+  return soln;
+}
+
+void
+SQLRandPass::releaseSinkSols()
+{
+  for (DenseMap<const CallInst *, InfoflowSolution *>::iterator it =
+           sinkSols.begin();
+       it != sinkSols.end();
+       ++it)
+    delete it->second;
+  sinkSols.clear();
+}
+
 InfoflowSolution *
 SQLRandPass::getBackwardsSolFromEntry(std::string sinkKind,
                                       CallInst *ci,
@@ -284,28 +538,61 @@ int
 SQLRandPass::doInitialization(Module &M)
 {
   infoflow = &getAnalysis<Infoflow>();
+  pti = &getAnalysis<PointsToInterface>();
+  callSpecs = &getCallSpecs();
   dbg("Initialization");
 
-  int sqlType = getSQLType(M);
+  indexCallSites(M);
+  sqlDialects = getSQLType(M);
 
-  if (sqlType == 0) {
-    /* MySQL */
+  if (sqlDialects == 0)
+    return -1;
+
+  /* a module may talk to both, every dialect gets its own mapping */
+  if (sqlDialects & (1 << DIALECT_MYSQL)) {
     dbg("Found db: MySQL");
-    hashSQLKeywords(true);
-  } else if (sqlType == 1) {
-    /* PGSQL */
+    hashSQLKeywords(DIALECT_MYSQL);
+  }
+  if (sqlDialects & (1 << DIALECT_PGSQL)) {
     dbg("Found db: PostgreSQL");
-    hashSQLKeywords(false);
-  } else {
-    /* abort */
-    return -1;
+    hashSQLKeywords(DIALECT_PGSQL);
   }
   unique_id = 0;
+  literalDialect.clear();
+  literalPlaintext.clear();
+  dialectCopies.clear();
+  plaintextTwins.clear();
+  pendingLiterals.clear();
+
+  findBulkDataChannels(M);
+  fragmentTables.clear();
+
+  incremental = false;
+  if (sqlrand::incrementalEnabled())
+    incremental = loadFunctionState(M);
 
   for (Module::global_iterator ii = M.global_begin();
        ii != M.global_end();
        ++ii){
     GlobalVariable *gv = ii;
+
+    /*
+     * Tables of query fragments, solved together with the sources. They
+     * hold no instruction operands to replay, so they are solved even in
+     * clean functions.
+     */
+    if (gv->hasInitializer() &&
+        (isa<ConstantArray>(gv->getInitializer()) ||
+         isa<ConstantStruct>(gv->getInitializer()))) {
+      std::vector<GlobalVariable *> strings;
+      getInitializerStrings(gv, strings);
+      if (!strings.empty())
+        fragmentTables.push_back(gv);
+      continue;
+    }
+
+    if (literalDialect.count(gv) || !usedInDirtyFunction(gv))
+      continue;
     if (gv->isConstant()) {
       std::string name = gv->getName().str();
       for (GlobalVariable::use_iterator U = gv->use_begin();
@@ -316,19 +603,11 @@ SQLRandPass::doInitialization(Module &M)
         if (isa<ConstantExpr>(user) && (val != NULL)) {
           InfoflowSolution *fsoln =
               getForwardSolFromGlobal(name, val);
-          if (backwardsFromGlobal(M, fsoln, val) &&
+          int dialect;
+          if (backwardsFromGlobal(M, fsoln, val, dialect) &&
               gv->hasInitializer()) {
             dbg("FOUND mysql from global Variable");
-            ConstantDataSequential *cds =
-                dyn_cast<ConstantDataSequential>(gv->getInitializer());
-            std::string sanitized =
-                sanitizeString(cds->getAsString().str());
-            Constant *san =
-                ConstantDataArray::getString(M.getContext(),
-                                             sanitized, false);
-            if (san->getType() == gv->getInitializer()->getType()) {
-              gv->setInitializer(san);
-            }
+            sanitizeGlobal(M, gv, dialect);
           }
         }
       }
@@ -340,77 +619,125 @@ SQLRandPass::doInitialization(Module &M)
 
 
 void
-SQLRandPass::sanitizeLiteralsBackwards(Module &M, InfoflowSolution *sol)
+SQLRandPass::sanitizeLiteralsBackwards(Module &M, InfoflowSolution *sol,
+                                       int dialect)
 {
-  for (Module::iterator mi = M.begin(); mi != M.end(); mi++) {
-    Function& F = *mi;
-    for (Function::iterator bi = F.begin(); bi != F.end(); bi++) {
-      BasicBlock& B = *bi;
-      for (BasicBlock::iterator ii = B.begin(); ii !=B.end(); ii++) {
-        if (CallInst* ci = dyn_cast<CallInst>(ii)) {
-          Function* f = ci->getCalledFunction();
-          if (!f)
-            continue;
-
-          for (size_t i = 0; i < ci->getNumArgOperands(); i++) {
-            if (isLiteral(ci->getArgOperand(i)) &&
-                checkBackwardTainted(*(ci->getArgOperand(i)),sol)) {
-              Value *s = sanitizeArgOp(M,
-                                       ci->getArgOperand(i));
-
-              ci->setArgOperand(i, s);
-            }
-          }
-        }
+  for (std::vector<WeakVH>::iterator it = callSites.literalCalls.begin();
+       it != callSites.literalCalls.end();
+       ++it) {
+    /* rewritten sinks are followed to their __sqlrand_ call */
+    Value *v = *it;
+    CallInst *ci = dyn_cast_or_null<CallInst>(v);
+    if (!ci)
+      continue;
+
+    Function *f = ci->getCalledFunction();
+    if (!f || isBulkDataCall(f) ||
+        bulkFunctions.count(ci->getParent()->getParent()) ||
+        !isDirty(ci->getParent()->getParent()))
+      continue;
+
+    for (size_t i = 0; i < ci->getNumArgOperands(); i++) {
+      if (isLiteral(ci->getArgOperand(i)) &&
+          !isRandomized(ci->getArgOperand(i), dialect) &&
+          !feedsBulkData(ci->getArgOperand(i)) &&
+          checkBackwardTainted(*(ci->getArgOperand(i)),sol)) {
+        Value *s = sanitizeArgOp(M,
+                                 ci->getArgOperand(i),
+                                 dialect);
+
+        ci->setArgOperand(i, s);
       }
     }
   }
 }
+/*
+ * Rewrite every sink into its __sqlrand_ wrapper. The sinks were collected
+ * up front by indexCallSites() and are taken from that worklist one by one,
+ * so each is sanitized and replaced exactly once however many of them
+ * share a basic block.
+ *
+ * The literals reaching sinks whose query is built at run time are found
+ * afterwards in one walk over the literal calls per dialect, against a
+ * single backward solution in which every such sink of the dialect is a
+ * sink, rather than walking them once per sink.
+ */
 void
 SQLRandPass::doFinalization(Module &M)
 {
   dbg("Removing checks");
-  for (Module::iterator mi = M.begin(); mi != M.end(); mi++) {
-    Function& F = *mi;
-    for (Function::iterator bi = F.begin(); bi != F.end(); bi++) {
-      BasicBlock& B = *bi;
-      for (BasicBlock::iterator ii = B.begin(); ii !=B.end(); ii++) {
-        if (CallInst* ci = dyn_cast<CallInst>(ii)) {
-          Function* f = ci->getCalledFunction();
-          if (!f)
-            continue;
-
-          const CallTaintEntry *entry =
-              findEntryForFunction(sanitizeSummaries, f->getName());
-          if (entry->Name) {
-            /* Update the arg if it is a ConstExpr */
-            if (isLiteral(ci->getArgOperand(1))) {
-              Value *s = sanitizeArgOp(M,
-                                       ci->getArgOperand(1));
-
-              ci->setArgOperand(1, s);
-            } else {
-              std::string sinkKind = getKindId("sql", &unique_id);
-              InfoflowSolution *soln = getBackwardsSol(sinkKind,
-                                                       ci);
-
-              sanitizeLiteralsBackwards(M, soln);
-            }
-            /* Construct Function */
-            insertSQLCheckFunction(M,
-                                   "__sqlrand_" + f->getName().str(),
-                                   ci,
-                                   ii);
-            ii = B.begin();
-          }
-        }
+  std::string dynamicSinks[NUM_DIALECTS];
+  std::vector<int> dialects;
+  for (std::vector<CallInst *>::iterator it = callSites.sinks.begin();
+       it != callSites.sinks.end();
+       ++it) {
+    CallInst *ci = *it;
+    Function *f = ci->getCalledFunction();
+    const CallSpec *spec = getCallSpec(ci);
+
+    /* literals are randomized for the dialect of this sink */
+    int dialect = spec->dialect;
+    unsigned arg = spec->queryArg;
+
+    /* Update the arg if it is a ConstExpr */
+    if (isLiteral(ci->getArgOperand(arg))) {
+      Value *s = sanitizeArgOp(M,
+                               ci->getArgOperand(arg),
+                               dialect);
+
+      ci->setArgOperand(arg, s);
+    } else if (isDirty(ci->getParent()->getParent())) {
+      /* registered before @ci is replaced by its wrapper */
+      if (dynamicSinks[dialect].empty()) {
+        dynamicSinks[dialect] = getKindId("sqldyn", &unique_id);
+        dialects.push_back(dialect);
       }
+      infoflow->setUntainted(dynamicSinks[dialect], *ci);
     }
+
+    /* wrappers of the application check the query in their own module */
+    if (!spec->wrapped)
+      continue;
+
+    /* Construct Function */
+    *it = insertSQLCheckFunction(M,
+                                 "__sqlrand_" + f->getName().str(),
+                                 ci);
+  }
+
+  /* in the order of their first sink, which wins for shared literals */
+  for (size_t i = 0; i < dialects.size(); i++) {
+    std::set<std::string> kinds;
+    kinds.insert(dynamicSinks[dialects[i]]);
+    InfoflowSolution *soln = infoflow->greatestSolution(kinds, false);
+    sanitizeLiteralsBackwards(M, soln, dialects[i]);
+    delete soln;
   }
+
+  rewriteLiterals(M);
+}
+
+/*
+ * True if the string behind the literal @op has already been randomized
+ * for @dialect. Saves the solution lookup for literals shared by many
+ * sinks; one randomized for the other dialect still needs its copy.
+ */
+bool
+SQLRandPass::isRandomized(Value *op, int dialect)
+{
+  ConstantExpr *constExpr = dyn_cast<ConstantExpr>(op);
+  if (constExpr == NULL)
+    return false;
+
+  GlobalVariable *gv = dyn_cast<GlobalVariable>(constExpr->getOperand(0));
+  if (gv == NULL)
+    return false;
+  std::map<const GlobalVariable *, int>::iterator it = literalDialect.find(gv);
+  return it != literalDialect.end() && it->second == dialect;
 }
 
 Value *
-SQLRandPass::sanitizeArgOp(Module &M, Value *op)
+SQLRandPass::sanitizeArgOp(Module &M, Value *op, int dialect)
 {
   ConstantExpr *constExpr = dyn_cast<ConstantExpr>(op);
   GlobalVariable *gv = dyn_cast<GlobalVariable>(constExpr->getOperand(0));
@@ -418,17 +745,169 @@ SQLRandPass::sanitizeArgOp(Module &M, Value *op)
   if (gv == NULL || !gv->hasInitializer())
     return op;
 
+  /* a literal already randomized for the other dialect: use a copy */
+  std::map<const GlobalVariable *, int>::iterator seen =
+      literalDialect.find(gv);
+  if (seen != literalDialect.end() && seen->second != dialect) {
+    GlobalVariable *copy = getDialectCopy(M, gv, dialect);
+    if (copy != NULL)
+      return constExpr->getWithOperandReplaced(0, copy);
+  }
+
+  sanitizeGlobal(M, gv, dialect);
+  return op;
+}
+
+/*
+ * A copy of the randomized literal @gv for the sinks of @dialect, which
+ * are then pointed at it. Clang gives identical literals of a module one
+ * global, so `mysql_query(m, "BEGIN"); PQexec(p, "BEGIN");` share it, and
+ * the runtime of each dialect only knows its own mapping. NULL if @gv may
+ * be written, when the uses must keep sharing it.
+ */
+GlobalVariable *
+SQLRandPass::getDialectCopy(Module &M, GlobalVariable *gv, int dialect)
+{
+  if (!gv->isConstant())
+    return NULL;
+
+  GlobalVariable *&copy = dialectCopies[std::make_pair(gv, dialect)];
+  if (copy == NULL) {
+    std::map<const GlobalVariable *, std::string>::iterator it =
+        literalPlaintext.find(gv);
+    if (it == literalPlaintext.end())
+      return NULL;
+
+    Constant *init =
+        ConstantDataArray::getString(M.getContext(), it->second, false);
+    copy = new GlobalVariable(M, init->getType(), true,
+                              GlobalValue::PrivateLinkage, init,
+                              Twine(gv->getName()) + "." +
+                                  getDialectName(dialect));
+    copy->setUnnamedAddr(true);
+    copy->setAlignment(gv->getAlignment());
+    dbgMsg(gv->getName().str() +
+               " reaches sinks of both dialects, copied for ",
+           getDialectName(dialect));
+    sanitizeGlobal(M, copy, dialect);
+  }
+  return copy;
+}
+
+/*
+ * Randomize the keywords of the string literal @gv for @dialect. The
+ * literal counts as randomized from here on; its initializer is replaced
+ * by the next rewriteLiterals().
+ */
+void
+SQLRandPass::sanitizeGlobal(Module &M, GlobalVariable *gv, int dialect)
+{
   std::string var_name = gv->getName().str();
   ConstantDataSequential *cds =
       dyn_cast<ConstantDataSequential>(gv->getInitializer());
 
+  /*
+   * A literal is randomized once. If it also reaches a sink of the other
+   * dialect its keywords stay those of the first one.
+   */
+  std::map<const GlobalVariable *, int>::iterator seen =
+      literalDialect.find(gv);
+  if (seen != literalDialect.end()) {
+    if (seen->second != dialect)
+      dbgMsg(var_name + " reaches sinks of both dialects, kept as ",
+             getDialectName(seen->second));
+    return;
+  }
+
   if (cds != NULL && cds->isString()) {
-    std::string sanitized = sanitizeString(cds->getAsString().str());
-    Constant *san =
-        ConstantDataArray::getString(M.getContext(), sanitized, false);
+    literalDialect[gv] = dialect;
+    literalPlaintext[gv] = cds->getAsString().str();
+    pendingLiterals.push_back(gv);
+  }
+}
+
+namespace {
+
+/* literals of one rewriteLiterals(), shared by its sanitizeWorkers */
+struct LiteralWork {
+  std::vector<const std::string *> plain;
+  std::vector<int> dialect;
+  std::vector<std::string> sanitized;
+  volatile sys::cas_flag next;
+};
+
+}
+
+/* literals below which rewriteLiterals() does not start another thread */
+static const size_t LITERALS_PER_THREAD = 1024;
+
+/*
+ * Take literals of the LiteralWork @arg until there are none left. Only
+ * reads the keyword tries, so any number of them can run at once.
+ */
+void *
+SQLRandPass::sanitizeWorker(void *arg)
+{
+  LiteralWork *work = (LiteralWork *) arg;
+  deps::TraceSpan Span("sqlrand", "sqlrand.literals worker");
+
+  for (;;) {
+    size_t i = sys::AtomicIncrement(&work->next) - 1;
+    if (i >= work->plain.size())
+      break;
+    work->sanitized[i] = sanitizeString(*work->plain[i], work->dialect[i]);
+  }
+  return NULL;
+}
+
+/*
+ * Randomize the literals picked since the last call. Rewriting the strings
+ * is independent per literal and is spread over -sqlrand-threads threads;
+ * the new initializers are created and set here, on the pass's thread,
+ * since constants are uniqued in the LLVMContext.
+ */
+void
+SQLRandPass::rewriteLiterals(Module &M)
+{
+  if (pendingLiterals.empty())
+    return;
+  deps::TraceSpan Span("sqlrand", "sqlrand.literals");
+
+  LiteralWork work;
+  work.next = 0;
+  for (size_t i = 0; i < pendingLiterals.size(); i++) {
+    work.plain.push_back(&literalPlaintext[pendingLiterals[i]]);
+    work.dialect.push_back(literalDialect[pendingLiterals[i]]);
+  }
+  work.sanitized.resize(work.plain.size());
+
+  unsigned threads = SQLRandThreads;
+  if (threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? cpus : 1;
+  }
+  threads = std::min<size_t>(threads,
+                             work.plain.size() / LITERALS_PER_THREAD + 1);
+
+  /* this thread takes its share as well */
+  std::vector<pthread_t> pool;
+  for (unsigned t = 1; t < threads; t++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, sanitizeWorker, &work) != 0)
+      break;
+    pool.push_back(thread);
+  }
+  sanitizeWorker(&work);
+  for (size_t t = 0; t < pool.size(); t++)
+    pthread_join(pool[t], NULL);
+
+  for (size_t i = 0; i < pendingLiterals.size(); i++) {
+    GlobalVariable *gv = pendingLiterals[i];
+    Constant *san = ConstantDataArray::getString(M.getContext(),
+                                                 work.sanitized[i], false);
 
     if (san->getType() == gv->getInitializer()->getType()) {
-      dbgMsg(cds->getAsString().str() + " becomes :", sanitized);
+      dbgMsg(*work.plain[i] + " becomes :", work.sanitized[i]);
       gv->setInitializer(san);
     } else {
       san->getType()->dump();
@@ -437,102 +916,742 @@ SQLRandPass::sanitizeArgOp(Module &M, Value *op)
       errs() << "\n";
     }
   }
-  constExpr->setOperand(0, gv);
-  return dyn_cast<Value>(constExpr);
+  pendingLiterals.clear();
+}
+
+/*
+ * Collect the string literals reachable from the initializer @C: elements
+ * of constant arrays, fields of constant structs, and the initializers of
+ * the globals they point to, e.g. every string of
+ *
+ *   static const char *fragments[] = { "SELECT a FROM t", " WHERE " };
+ */
+void
+SQLRandPass::collectInitializerStrings(Constant *C,
+                                       std::set<const GlobalVariable *> &visited,
+                                       std::vector<GlobalVariable *> &strings)
+{
+  if (GlobalVariable *gv = dyn_cast<GlobalVariable>(C)) {
+    if (!gv->hasInitializer() || !visited.insert(gv).second)
+      return;
+
+    ConstantDataSequential *cds =
+        dyn_cast<ConstantDataSequential>(gv->getInitializer());
+    if (cds != NULL && cds->isString()) {
+      if (gv->isConstant() && !bulkPayloads.count(gv))
+        strings.push_back(gv);
+      return;
+    }
+    collectInitializerStrings(gv->getInitializer(), visited, strings);
+    return;
+  }
+
+  /* GEPs and casts of the globals, and the members of aggregates */
+  if (isa<ConstantExpr>(C) || isa<ConstantArray>(C) || isa<ConstantStruct>(C))
+    for (unsigned i = 0; i < C->getNumOperands(); i++)
+      collectInitializerStrings(cast<Constant>(C->getOperand(i)), visited,
+                                strings);
+}
+
+/* The string literals in the initializer of @gv */
+void
+SQLRandPass::getInitializerStrings(GlobalVariable *gv,
+                                   std::vector<GlobalVariable *> &strings)
+{
+  std::set<const GlobalVariable *> visited;
+  visited.insert(gv);
+  collectInitializerStrings(gv->getInitializer(), visited, strings);
+}
+
+/*
+ * Randomize the string literals in the initializer of @gv that reach a
+ * sink. @fsoln is the forward solution of the table; each fragment is
+ * checked on its own against the backward solution of every sink the
+ * table reaches, so unrelated strings sharing the table (usage text,
+ * messages) are left alone, and each fragment is randomized for the
+ * dialect of the first sink it reaches.
+ */
+void
+SQLRandPass::sanitizeAggregate(Module &M, GlobalVariable *gv,
+                               InfoflowSolution *fsoln)
+{
+  std::vector<GlobalVariable *> strings;
+  getInitializerStrings(gv, strings);
+
+  for (std::vector<CallInst *>::iterator it = callSites.sinks.begin();
+       it != callSites.sinks.end() && !strings.empty();
+       ++it) {
+    CallInst *ci = *it;
+    const CallSpec *spec = getCallSpec(ci);
+    if (!checkForwardTainted(*(ci->getArgOperand(spec->queryArg)), fsoln))
+      continue;
+
+    dbg("Found query fragments in " + gv->getName().str());
+    InfoflowSolution *soln = getSinkSol(ci);
+    for (size_t i = 0; i < strings.size(); ) {
+      if (!checkBackwardTainted(*strings[i], soln)) {
+        i++;
+        continue;
+      }
+      if (!literalDialect.count(strings[i]))
+        ++NumAggregateLiterals;
+      sanitizeGlobal(M, strings[i], spec->dialect);
+      strings.erase(strings.begin() + i);
+    }
+  }
+}
+
+/*
+ * Hash every function of @M and compare with the state saved by the last
+ * build of this module. Changed functions are dirty, and so is everything
+ * taint can flow through to or from them: the functions that requested
+ * their summaries in the interprocedural analysis, transitively, the
+ * functions whose summaries they requested, transitively, and the
+ * functions that load or store an abstract location a dirty function
+ * loads or stores, which catches taint passed through globals and the
+ * heap. Literal uses recorded in the remaining, clean functions are
+ * randomized again without solving anything. Returns false when there is
+ * no usable state, or when a dirty function touches memory the points-to
+ * analysis knows nothing about, and the whole module has to be solved.
+ */
+bool
+SQLRandPass::loadFunctionState(Module &M)
+{
+  functionHashes.clear();
+  dirtyFunctions.clear();
+  for (Module::iterator fi = M.begin(); fi != M.end(); ++fi)
+    if (!fi->isDeclaration())
+      functionHashes[fi->getName().str()] = sqlrand::getFunctionHash(*fi);
+
+  sqlrand::FunctionState prev;
+  if (!sqlrand::readFunctionState(M, prev))
+    return false;
+
+  std::vector<const Function *> next;
+  for (Module::iterator fi = M.begin(); fi != M.end(); ++fi) {
+    std::map<std::string, uint64_t>::iterator cur =
+        functionHashes.find(fi->getName().str());
+    if (cur == functionHashes.end())
+      continue;
+    std::map<std::string, uint64_t>::iterator old =
+        prev.hashes.find(cur->first);
+    if (old == prev.hashes.end() || old->second != cur->second) {
+      dirtyFunctions.insert(fi);
+      next.push_back(fi);
+    }
+  }
+
+  std::map<const Function *, std::set<const Function *> > callers, callees;
+  infoflow->getFunctionDependencies(callers);
+  for (std::map<const Function *, std::set<const Function *> >::iterator it =
+           callers.begin();
+       it != callers.end();
+       ++it)
+    for (std::set<const Function *>::iterator ci = it->second.begin();
+         ci != it->second.end();
+         ++ci)
+      callees[*ci].insert(it->first);
+
+  /* who loads or stores each abstract location */
+  std::map<const Function *, AbstractLocSet> accessed;
+  std::map<const AbstractLoc *, std::set<const Function *> > accessors;
+  std::set<const Function *> unknown;
+  for (Module::iterator fi = M.begin(); fi != M.end(); ++fi) {
+    if (fi->isDeclaration())
+      continue;
+    AbstractLocSet &locs = accessed[fi];
+    if (!getAccessedLocations(fi, locs))
+      unknown.insert(fi);
+    for (AbstractLocSet::iterator li = locs.begin(); li != locs.end(); ++li)
+      accessors[*li].insert(fi);
+  }
+
+  std::set<const Function *> upSeen, downSeen, memSeen;
+  std::set<const AbstractLoc *> shared;
+  while (!next.empty()) {
+    std::vector<const Function *> up, down;
+    for (size_t i = 0; i < next.size(); i++) {
+      if (upSeen.insert(next[i]).second)
+        up.push_back(next[i]);
+      if (downSeen.insert(next[i]).second)
+        down.push_back(next[i]);
+    }
+    next.clear();
+
+    while (!up.empty()) {
+      std::set<const Function *> &related = callers[up.back()];
+      up.pop_back();
+      for (std::set<const Function *>::iterator it = related.begin();
+           it != related.end();
+           ++it)
+        if (upSeen.insert(*it).second) {
+          dirtyFunctions.insert(*it);
+          up.push_back(*it);
+        }
+    }
+    while (!down.empty()) {
+      std::set<const Function *> &related = callees[down.back()];
+      down.pop_back();
+      for (std::set<const Function *>::iterator it = related.begin();
+           it != related.end();
+           ++it)
+        if (downSeen.insert(*it).second) {
+          dirtyFunctions.insert(*it);
+          down.push_back(*it);
+        }
+    }
+
+    /* taint stored by one dirty function may be loaded by any other */
+    for (std::set<const Function *>::iterator fi = dirtyFunctions.begin();
+         fi != dirtyFunctions.end();
+         ++fi) {
+      if (!memSeen.insert(*fi).second)
+        continue;
+      if (unknown.count(*fi)) {
+        dbg("Incremental: " + (*fi)->getName().str() +
+            " accesses memory without points-to information, solving the"
+            " whole module");
+        ++NumIncrementalFallbacks;
+        dirtyFunctions.clear();
+        return false;
+      }
+      AbstractLocSet &locs = accessed[*fi];
+      for (AbstractLocSet::iterator li = locs.begin(); li != locs.end(); ++li) {
+        if (!shared.insert(*li).second)
+          continue;
+        std::set<const Function *> &users = accessors[*li];
+        for (std::set<const Function *>::iterator ui = users.begin();
+             ui != users.end();
+             ++ui)
+          if (!dirtyFunctions.count(*ui))
+            next.push_back(*ui);
+      }
+    }
+    for (size_t i = 0; i < next.size(); i++)
+      dirtyFunctions.insert(next[i]);
+  }
+  NumDirtyFunctions += dirtyFunctions.size();
+
+  for (size_t i = 0; i < prev.literals.size(); i++) {
+    const sqlrand::LiteralUse &use = prev.literals[i];
+    Function *F = M.getFunction(use.function);
+    if (F == NULL || F->isDeclaration() || dirtyFunctions.count(F) ||
+        !(sqlDialects & (1 << use.dialect)))
+      continue;
+
+    unsigned n = 0;
+    for (inst_iterator ii = inst_begin(F); ii != inst_end(F); ++ii, ++n) {
+      if (n != use.inst)
+        continue;
+      if (use.operand < ii->getNumOperands()) {
+        Value *op = ii->getOperand(use.operand);
+        GlobalVariable *gv = dyn_cast<GlobalVariable>(op->stripPointerCasts());
+        if (gv != NULL && gv->hasInitializer()) {
+          /* may need the copy made for a second dialect */
+          if (isa<ConstantExpr>(op) &&
+              cast<ConstantExpr>(op)->getOperand(0) == gv)
+            ii->setOperand(use.operand, sanitizeArgOp(M, op, use.dialect));
+          else
+            sanitizeGlobal(M, gv, use.dialect);
+          ++NumReplayedLiterals;
+        }
+      }
+      break;
+    }
+  }
+
+  dbgMsg("Incremental: functions to solve ",
+         utostr(dirtyFunctions.size()));
+  return true;
+}
+
+/*
+ * Add to @locs the abstract locations @F loads or stores itself or through
+ * a function without a body; callees with one are followed through the
+ * summary dependencies instead. False if the points-to analysis has no
+ * location for some pointer @F dereferences.
+ */
+bool
+SQLRandPass::getAccessedLocations(const Function *F, AbstractLocSet &locs)
+{
+  for (const_inst_iterator ii = inst_begin(F); ii != inst_end(F); ++ii) {
+    const Value *ptr = NULL;
+    if (const LoadInst *li = dyn_cast<LoadInst>(&*ii)) {
+      ptr = li->getPointerOperand();
+    } else if (const StoreInst *si = dyn_cast<StoreInst>(&*ii)) {
+      ptr = si->getPointerOperand();
+    } else if (const CallInst *ci = dyn_cast<CallInst>(&*ii)) {
+      const Function *callee = ci->getCalledFunction();
+      if (callee != NULL && !callee->isDeclaration())
+        continue;
+      for (unsigned i = 0; i < ci->getNumArgOperands(); i++) {
+        if (!ci->getArgOperand(i)->getType()->isPointerTy())
+          continue;
+        const AbstractLocSet *reach =
+            pti->getReachableAbstractLocSetForValue(ci->getArgOperand(i));
+        locs.insert(reach->begin(), reach->end());
+      }
+      continue;
+    }
+    if (ptr == NULL)
+      continue;
+
+    const AbstractLocSet *at = pti->getAbstractLocSetForValue(ptr);
+    if (at->empty())
+      return false;
+    locs.insert(at->begin(), at->end());
+  }
+  return true;
+}
+
+/*
+ * Save the hashes taken by loadFunctionState() and every operand that now
+ * refers to a randomized literal. Must run before anything is added to @M.
+ */
+void
+SQLRandPass::saveFunctionState(Module &M)
+{
+  sqlrand::FunctionState state;
+  state.hashes = functionHashes;
+
+  for (Module::iterator fi = M.begin(); fi != M.end(); ++fi) {
+    if (!functionHashes.count(fi->getName().str()))
+      continue;
+
+    unsigned n = 0;
+    for (inst_iterator ii = inst_begin(fi); ii != inst_end(fi); ++ii, ++n) {
+      for (unsigned i = 0; i < ii->getNumOperands(); i++) {
+        GlobalVariable *gv =
+            dyn_cast<GlobalVariable>(ii->getOperand(i)->stripPointerCasts());
+        if (gv == NULL)
+          continue;
+        std::map<const GlobalVariable *, int>::iterator it =
+            literalDialect.find(gv);
+        if (it == literalDialect.end())
+          continue;
+
+        sqlrand::LiteralUse use;
+        use.function = fi->getName().str();
+        use.inst = n;
+        use.operand = i;
+        use.dialect = it->second;
+        state.literals.push_back(use);
+      }
+    }
+  }
+
+  if (!sqlrand::writeFunctionState(M, state))
+    dbg("Could not write function state of " + M.getModuleIdentifier());
+}
+
+/*
+ * Does the analysis have to look at @F? Always, unless running
+ * incrementally and @F is clean.
+ */
+bool
+SQLRandPass::isDirty(const Function *F)
+{
+  return !incremental || dirtyFunctions.count(F) != 0;
+}
+
+/*
+ * Is @V used, possibly through constant expressions, by an instruction of
+ * a dirty function?
+ */
+bool
+SQLRandPass::usedInDirtyFunction(const Value *V)
+{
+  if (!incremental)
+    return true;
+
+  for (Value::const_use_iterator U = V->use_begin();
+       U != V->use_end();
+       ++U) {
+    if (const Instruction *I = dyn_cast<Instruction>(*U)) {
+      if (isDirty(I->getParent()->getParent()))
+        return true;
+    } else if (isa<Constant>(*U) && !isa<GlobalValue>(*U) &&
+               usedInDirtyFunction(*U)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Record what the analysis decided for @M: the literals randomized and the
+ * sinks rewritten, by position. Must run before anything is added to @M.
+ */
+void
+SQLRandPass::saveCacheEntry(Module &M, const std::string &key)
+{
+  sqlrand::CacheEntry entry;
+  entry.dialects = sqlDialects;
+
+  std::set<const GlobalVariable *> copies;
+  for (std::map<std::pair<const GlobalVariable *, int>,
+                GlobalVariable *>::iterator it = dialectCopies.begin();
+       it != dialectCopies.end();
+       ++it)
+    copies.insert(it->second);
+
+  unsigned n = 0;
+  for (Module::global_iterator gi = M.global_begin();
+       gi != M.global_end();
+       ++gi, ++n) {
+    std::map<const GlobalVariable *, int>::iterator it =
+        literalDialect.find(gi);
+    if (it != literalDialect.end() && !copies.count(gi))
+      entry.literals.push_back(std::make_pair(it->second, n));
+  }
+
+  std::set<const Instruction *> rewritten;
+  for (std::vector<CallInst *>::iterator it = callSites.sinks.begin();
+       it != callSites.sinks.end();
+       ++it)
+    if ((*it)->getCalledFunction()->getName().startswith("__sqlrand_"))
+      rewritten.insert(*it);
+  unsigned f = 0;
+  for (Module::iterator fi = M.begin(); fi != M.end(); ++fi, ++f) {
+    n = 0;
+    for (inst_iterator ii = inst_begin(fi); ii != inst_end(fi); ++ii, ++n) {
+      if (rewritten.count(&*ii))
+        entry.sinks.push_back(std::make_pair(f, n));
+      for (unsigned i = 0; i < ii->getNumOperands(); i++) {
+        ConstantExpr *op = dyn_cast<ConstantExpr>(ii->getOperand(i));
+        if (op == NULL)
+          continue;
+        GlobalVariable *gv = dyn_cast<GlobalVariable>(op->getOperand(0));
+        if (gv == NULL || !copies.count(gv))
+          continue;
+        sqlrand::CopyUse use = { literalDialect[gv], f, n, i };
+        entry.copies.push_back(use);
+      }
+    }
+  }
+
+  if (!sqlrand::writeCacheEntry(key, entry))
+    dbg("Could not write cache entry " + key);
+}
+
+/*
+ * Apply a cached result to @M without any analysis: randomize the recorded
+ * literals and wrap the recorded sinks.
+ */
+void
+SQLRandPass::replayCacheEntry(Module &M, const sqlrand::CacheEntry &entry)
+{
+  sqlDialects = entry.dialects;
+  literalDialect.clear();
+  literalPlaintext.clear();
+  dialectCopies.clear();
+  plaintextTwins.clear();
+  pendingLiterals.clear();
+  for (int d = 0; d < NUM_DIALECTS; d++)
+    if (sqlDialects & (1 << d))
+      hashSQLKeywords(d);
+
+  std::vector<GlobalVariable *> globals;
+  for (Module::global_iterator gi = M.global_begin();
+       gi != M.global_end();
+       ++gi)
+    globals.push_back(gi);
+
+  for (size_t i = 0; i < entry.literals.size(); i++)
+    sanitizeGlobal(M, globals[entry.literals[i].second],
+                   entry.literals[i].first);
+
+  std::vector<Function *> functions;
+  for (Module::iterator fi = M.begin(); fi != M.end(); ++fi)
+    functions.push_back(fi);
+  for (size_t i = 0; i < entry.copies.size(); i++) {
+    const sqlrand::CopyUse &use = entry.copies[i];
+    unsigned n = 0;
+    for (inst_iterator ii = inst_begin(functions[use.function]);
+         ii != inst_end(functions[use.function]);
+         ++ii, ++n) {
+      if (n == use.inst) {
+        ii->setOperand(use.operand,
+                       sanitizeArgOp(M, ii->getOperand(use.operand),
+                                     use.dialect));
+        break;
+      }
+    }
+  }
+  rewriteLiterals(M);
+
+  std::set<std::pair<unsigned, unsigned> > positions(entry.sinks.begin(),
+                                                     entry.sinks.end());
+  std::vector<CallInst *> sinks;
+  unsigned f = 0;
+  for (Module::iterator fi = M.begin(); fi != M.end(); ++fi, ++f) {
+    unsigned n = 0;
+    for (inst_iterator ii = inst_begin(fi); ii != inst_end(fi); ++ii, ++n)
+      if (positions.count(std::make_pair(f, n)))
+        sinks.push_back(cast<CallInst>(&*ii));
+  }
+
+  for (size_t i = 0; i < sinks.size(); i++)
+    insertSQLCheckFunction(M,
+                           "__sqlrand_" +
+                               sinks[i]->getCalledFunction()->getName().str(),
+                           sinks[i]);
+  dbg("Replayed cached result");
 }
 
 
 bool
 SQLRandPass::runOnModule(Module &M)
 {
-  int ret = doInitialization(M);
+  double pipelineStart = 0;
+  if (sqlrand::statsEnabled())
+    pipelineStart = sqlrand::takePipelineStart(M);
+
+  phases = PhaseTimes();
+  numRewritten = 0;
+  constQuerySites.clear();
+  {
+    deps::TraceSpan Span("sqlrand", "SQLRand", M.getModuleIdentifier());
+    instrumentModule(M);
+  }
+
+  if (sqlrand::statsEnabled())
+    writeStats(M, pipelineStart);
+  return false;
+}
+
+void
+SQLRandPass::instrumentModule(Module &M)
+{
+  std::string cacheKey;
+
+  if (sqlrand::cacheEnabled()) {
+    /* the key of the module as it was before any analysis */
+    cacheKey = sqlrand::getCacheKeyFromModule(M);
+    bool hit = M.getNamedMetadata(DEPS_SKIP_ANALYSIS_MD) != NULL;
+    sqlrand::clearCacheMarkers(M);
+
+    if (hit) {
+      sqlrand::CacheEntry entry;
+      if (sqlrand::readCacheEntry(cacheKey, entry)) {
+        {
+          deps::PhaseRegion Region(phases.replay);
+          deps::TraceSpan Span("sqlrand", "sqlrand.replay");
+          replayCacheEntry(M, entry);
+        }
+        deps::PhaseRegion Region(phases.emit);
+        deps::TraceSpan Span("sqlrand", "sqlrand.emit");
+        emitConstQueryChecks(M);
+        emitMapping(M);
+        if (!SQLRandRuntimeBC.empty())
+          linkRuntime(M);
+        return;
+      }
+      report_fatal_error("SQLRand cache entry " + cacheKey +
+                         " vanished after the analysis was skipped");
+    }
+
+    if (cacheKey.empty())
+      cacheKey = sqlrand::getModuleKey(M);
+  }
+
+  int ret;
+  {
+    deps::PhaseRegion Region(phases.init);
+    deps::TraceSpan Span("sqlrand", "sqlrand.init");
+    ret = doInitialization(M);
+  }
   /* If we did not find SQL abort */
-  if (ret == -1)
-    return false;
+  if (ret == -1) {
+    if (!cacheKey.empty())
+      saveCacheEntry(M, cacheKey);
+    return;
+  }
 
-  for (Module::iterator mi = M.begin(); mi != M.end(); mi++) {
-    Function& F = *mi;
-    for (Function::iterator bi = F.begin(); bi != F.end(); bi++) {
-      BasicBlock& B = *bi;
-      for (BasicBlock::iterator ii = B.begin(); ii !=B.end(); ii++) {
-        if (CallInst* ci = dyn_cast<CallInst>(ii)) {
-          Function* f = ci->getCalledFunction();
-          if (!f)
-            continue;
-
-          /* Check if function needs to be sanitized */
-          const CallTaintEntry *entry =
-              findEntryForFunction(bLstSourceSummaries, f->getName());
-          if (entry->Name) {
-            std::string srcKind = getKindId("src", &unique_id);
-            InfoflowSolution *fsoln =
-                getForwardSolFromEntry(srcKind, ci, entry);
-
-            if (backwardSlicingBlacklisting(M, fsoln, ci)) {
-              if (f->getName() != "getenv") {
-                /* If we found mysql sanitize */
-                for (size_t i = 0;
-                     i < ci->getNumArgOperands();
-                     i++) {
-
-                  if (isLiteral(ci->getArgOperand(i))) {
-                    Value *s = sanitizeArgOp(M,
-                                             ci->getArgOperand(i));
-
-                    ci->setArgOperand(i, s);
-                  }
-                }
-              } else {
-                dbg("getenv called");
-                if (isLiteral(ci)) {
-                  dbg("Literal");
-                  //Value *s = sanitizeArgOp(M, ci);
-                  //ci = s;
-                }
-              }
-            }
+  {
+    deps::PhaseRegion Region(phases.sources);
+    deps::TraceSpan Span("sqlrand", "sqlrand.sources");
+    sanitizeSources(M);
+  }
+
+  {
+    deps::PhaseRegion Region(phases.sinks);
+    deps::TraceSpan Span("sqlrand", "sqlrand.sinks");
+    doFinalization(M);
+    releaseSinkSols();
+  }
+
+  deps::PhaseRegion Region(phases.emit);
+  deps::TraceSpan Span("sqlrand", "sqlrand.emit");
+  if (!cacheKey.empty())
+    saveCacheEntry(M, cacheKey);
+  if (sqlrand::incrementalEnabled())
+    saveFunctionState(M);
+
+  emitConstQueryChecks(M);
+  emitMapping(M);
+
+  if (!SQLRandRuntimeBC.empty())
+    linkRuntime(M);
+}
+
+/*
+ * Randomize the literal arguments of every source call that reaches a sink
+ */
+void
+SQLRandPass::sanitizeSources(Module &M)
+{
+  std::vector<CallInst *> sources;
+  std::vector<InfoflowSolution *> fsolns = getForwardSolsFromSources(sources);
+
+  for (size_t n = 0; n < sources.size(); n++) {
+    CallInst *ci = sources[n];
+    Function *f = ci->getCalledFunction();
+    InfoflowSolution *fsoln = fsolns[n];
+
+    int dialect;
+    bool reachesSink = backwardSlicingBlacklisting(M, fsoln, ci, dialect);
+    delete fsoln;
+
+    if (reachesSink) {
+      if (f->getName() != "getenv") {
+        /* If we found mysql sanitize */
+        for (size_t i = 0;
+             i < ci->getNumArgOperands();
+             i++) {
+
+          if (isLiteral(ci->getArgOperand(i)) &&
+              !feedsBulkData(ci->getArgOperand(i))) {
+            Value *s = sanitizeArgOp(M,
+                                     ci->getArgOperand(i),
+                                     dialect);
+
+            ci->setArgOperand(i, s);
           }
         }
+      } else {
+        dbg("getenv called");
+        if (isLiteral(ci)) {
+          dbg("Literal");
+          //Value *s = sanitizeArgOp(M, ci);
+          //ci = s;
+        }
       }
     }
   }
 
-  doFinalization(M);
-  return false;
+  /* the tables of query fragments follow the sources */
+  for (size_t n = 0; n < fragmentTables.size(); n++) {
+    InfoflowSolution *fsoln = fsolns[sources.size() + n];
+    sanitizeAggregate(M, fragmentTables[n], fsoln);
+    delete fsoln;
+  }
+}
+
+/*
+ * Constraint counts per kind, with the numeric suffix of per-source and
+ * per-sink kinds (src12, sql3, ...) dropped so that they add up.
+ */
+static sqlrand::JSONObject
+getConstraintCounts(const LHConstraintKit &kit)
+{
+  std::map<std::string, uint64_t> counts;
+  const StringMap<uint64_t> &byKind = kit.getConstraintCounts();
+  for (StringMap<uint64_t>::const_iterator it = byKind.begin();
+       it != byKind.end();
+       ++it) {
+    StringRef kind = it->getKey();
+    counts[kind.rtrim("0123456789").str()] += it->getValue();
+  }
+
+  sqlrand::JSONObject o;
+  for (std::map<std::string, uint64_t>::iterator it = counts.begin();
+       it != counts.end();
+       ++it)
+    o.add(it->first, it->second);
+  return o;
 }
 
+/*
+ * Append the -sqlrand-stats-json record of @M. @pipelineStart is when
+ * SQLRandCachePass ended, 0 if it did not run: what happened between it
+ * and PointsToInterface, or between PointsToInterface and Infoflow, is the
+ * DSA passes and the other analyses Infoflow requires.
+ */
+void
+SQLRandPass::writeStats(Module &M, double pipelineStart)
+{
+  /* not set by doInitialization() when the cache hit */
+  infoflow = &getAnalysis<Infoflow>();
+
+  const deps::PhaseTime &pointsTo = infoflow->getPointsToTime();
+  const deps::PhaseTime &constraints = infoflow->getAnalysisTime();
+
+  sqlrand::JSONObject times;
+  if (pipelineStart != 0 && pointsTo.Regions && constraints.Regions) {
+    sqlrand::JSONObject dsa;
+    dsa.add("wall_s", (pointsTo.Begin - pipelineStart) +
+                          (constraints.Begin - pointsTo.End));
+    times.add("dsa", dsa);
+  }
+  times.add("points-to", pointsTo);
+  times.add("constraints", constraints);
+  if (const LHConstraintKit *kit = infoflow->getConstraintKit())
+    times.add("solve", kit->getSolveTime());
+  times.add("sqlrand.replay", phases.replay);
+  times.add("sqlrand.init", phases.init);
+  times.add("sqlrand.sources", phases.sources);
+  times.add("sqlrand.sinks", phases.sinks);
+  times.add("sqlrand.emit", phases.emit);
+
+  sqlrand::JSONObject counters;
+  if (const LHConstraintKit *kit = infoflow->getConstraintKit()) {
+    counters.add("constraints", getConstraintCounts(*kit));
+    counters.add("variables", (uint64_t) kit->getNumVars());
+
+    sqlrand::JSONObject solves;
+    solves.add("least", (uint64_t) kit->getNumLeastSolves());
+    solves.add("greatest", (uint64_t) kit->getNumGreatestSolves());
+    solves.add("least_mt", (uint64_t) kit->getNumLeastMTSolves());
+    counters.add("solves", solves);
+  }
+  counters.add("call_sites_rewritten", (uint64_t) numRewritten);
+  counters.add("const_query_checks", (uint64_t) constQuerySites.size());
+  counters.add("literals_randomized", (uint64_t) literalDialect.size());
+
+  sqlrand::JSONObject record;
+  record.add("module", M.getModuleIdentifier());
+  record.add("phases", times);
+  record.add("counters", counters);
+  record.add("peak_rss_kb", (uint64_t) deps::PhaseTime::currentPeakRSS());
+
+  if (!sqlrand::appendStatsRecord(record.str()))
+    dbg("Could not write the stats report");
+}
+
+/*
+ * Does @srcCI reach a sink? On success @dialect is the dialect of that sink.
+ */
 bool
 SQLRandPass::backwardSlicingBlacklisting(Module &M,
                                          InfoflowSolution* fsoln,
-                                         CallInst* srcCI)
+                                         CallInst* srcCI,
+                                         int &dialect)
 {
-  for (Module::iterator mi = M.begin(); mi != M.end(); mi++) {
-    Function& F = *mi;
-    for (Function::iterator bi = F.begin(); bi != F.end(); bi++) {
-      BasicBlock& B = *bi;
-      for (BasicBlock::iterator ii = B.begin(); ii !=B.end(); ii++) {
-        if (CallInst* ci = dyn_cast<CallInst>(ii)) {
-          Function *f = ci->getCalledFunction();
-          if (!f)
-            continue;
-
-          const CallTaintEntry *entry =
-              findEntryForFunction(sanitizeSummaries, f->getName());
-          if (entry->Name) {
-            if (checkForwardTainted(*(ci->getOperand(1)), fsoln)) {
-
-              //this returns all sources that are tainted
-              std::string sinkKind = getKindId("sql", &unique_id);
-
-              InfoflowSolution *soln = getBackwardsSol(sinkKind,
-                                                       ci);
-
-              //check if source is in our list
-              if (checkBackwardTainted(*srcCI, soln))
-                return true;
-            }
-          }
-        }
+  for (std::vector<CallInst *>::iterator it = callSites.sinks.begin();
+       it != callSites.sinks.end();
+       ++it) {
+    CallInst *ci = *it;
+    const CallSpec *spec = getCallSpec(ci);
+    if (checkForwardTainted(*(ci->getArgOperand(spec->queryArg)), fsoln)) {
+
+      //this returns all sources that are tainted
+      InfoflowSolution *soln = getSinkSol(ci);
+
+      //check if source is in our list
+      if (checkBackwardTainted(*srcCI, soln)) {
+        dialect = spec->dialect;
+        return true;
       }
     }
   }
@@ -542,28 +1661,18 @@ SQLRandPass::backwardSlicingBlacklisting(Module &M,
 bool
 SQLRandPass::backwardsFromGlobal(Module &M,
                                  InfoflowSolution* fsoln,
-                                 Value* val)
+                                 Value* val,
+                                 int &dialect)
 {
-  for (Module::iterator mi = M.begin(); mi != M.end(); mi++) {
-    Function& F = *mi;
-    for (Function::iterator bi = F.begin(); bi != F.end(); bi++) {
-      BasicBlock& B = *bi;
-      for (BasicBlock::iterator ii = B.begin(); ii !=B.end(); ii++) {
-        if (CallInst* ci = dyn_cast<CallInst>(ii)) {
-          Function *f = ci->getCalledFunction();
-          if (!f)
-            continue;
-
-          const CallTaintEntry *entry =
-              findEntryForFunction(sanitizeSummaries, f->getName());
-          if (entry->Name) {
-            if (checkForwardTainted(*(ci->getOperand(1)), fsoln)) {
-              dbg("Found call from global (!)");
-              return true;
-            }
-          }
-        }
-      }
+  for (std::vector<CallInst *>::iterator it = callSites.sinks.begin();
+       it != callSites.sinks.end();
+       ++it) {
+    CallInst *ci = *it;
+    const CallSpec *spec = getCallSpec(ci);
+    if (checkForwardTainted(*(ci->getArgOperand(spec->queryArg)), fsoln)) {
+      dbg("Found call from global (!)");
+      dialect = spec->dialect;
+      return true;
     }
   }
   return false;
@@ -575,15 +1684,118 @@ SQLRandPass::backwardsFromGlobal(Module &M,
  * ============================================================================
  * ****************************************************************************/
 
-void
+static Constant *getStringPtr(Module &M, const std::string &str);
+
+/*
+ * If @query points into a constant literal that has been randomized,
+ * return the same pointer into a copy of the literal as it was before.
+ * NULL otherwise.
+ */
+Constant *
+SQLRandPass::getPlaintextQuery(Module &M, Value *query)
+{
+  ConstantExpr *constExpr = dyn_cast<ConstantExpr>(query);
+  if (constExpr == NULL)
+    return NULL;
+
+  GlobalVariable *gv = dyn_cast<GlobalVariable>(constExpr->getOperand(0));
+  if (gv == NULL || !gv->isConstant())
+    return NULL;
+
+  /* one twin per literal, shared by all the sites that send it */
+  GlobalVariable *&twin = plaintextTwins[gv];
+  if (twin == NULL) {
+    std::map<const GlobalVariable *, std::string>::iterator it =
+        literalPlaintext.find(gv);
+    if (it == literalPlaintext.end())
+      return NULL;
+
+    Constant *init =
+        ConstantDataArray::getString(M.getContext(), it->second, false);
+    if (init->getType() != gv->getInitializer()->getType())
+      return NULL;
+
+    twin = new GlobalVariable(M, init->getType(), true,
+                              GlobalValue::PrivateLinkage,
+                              init, ".sqlrand.plain");
+    twin->setUnnamedAddr(true);
+    twin->setAlignment(gv->getAlignment());
+  }
+  return constExpr->getWithOperandReplaced(0, twin);
+}
+
+/*
+ * Descriptor of the sink @ci, mirroring struct sqlrand_site in
+ * sqlrand_helpers.h: the site ID, the source location if @M has debug
+ * info, the dialect, SQLRAND_SITE_CONST_QUERY if the query (argument 1
+ * of every wrapped sink) is a literal, and the flag the runtime sets once
+ * it has verified that literal, if any. Returns a pointer to it.
+ */
+Constant *
+SQLRandPass::getSiteDescriptor(Module &M, CallInst *ci,
+                               GlobalVariable *verified)
+{
+  LLVMContext &C = M.getContext();
+  Type *i32 = Type::getInt32Ty(C);
+  Type *i8p = Type::getInt8PtrTy(C);
+
+  /* named like clang names the runtime's struct, so the linker merges them */
+  StructType *siteTy = M.getTypeByName("struct.sqlrand_site");
+  if (siteTy == NULL) {
+    Type *fields[] = { i32, i32, i8p, i32, i32, i32->getPointerTo() };
+    siteTy = StructType::create(C, fields, "struct.sqlrand_site");
+  }
+
+  std::string file;
+  unsigned line = 0;
+  DebugLoc loc = ci->getDebugLoc();
+  if (!loc.isUnknown()) {
+    DIScope scope(loc.getScope(C));
+    file = scope.getFilename().str();
+    line = loc.getLine();
+  }
+
+  int dialect = getSinkDialect(ci->getCalledFunction()->getName());
+  unsigned flags = isLiteral(ci->getArgOperand(1)) ? SQLRAND_SITE_CONST_QUERY
+                                                   : 0;
+
+  Constant *fields[] = {
+    ConstantInt::get(i32, numRewritten),
+    ConstantInt::get(i32, line),
+    file.empty() ? Constant::getNullValue(i8p) : getStringPtr(M, file),
+    ConstantInt::get(i32, dialect == DIALECT_MYSQL ? 1 : 0),
+    ConstantInt::get(i32, flags),
+    verified != NULL ? (Constant *) verified
+                     : Constant::getNullValue(i32->getPointerTo())
+  };
+  GlobalVariable *gv =
+      new GlobalVariable(M, siteTy, true, GlobalValue::PrivateLinkage,
+                         ConstantStruct::get(siteTy, fields),
+                         "__sqlrand_site");
+  return gv;
+}
+
+CallInst *
 SQLRandPass::insertSQLCheckFunction(Module &M,
                                     std::string name,
-                                    CallInst *ci,
-                                    BasicBlock::iterator ii)
+                                    CallInst *ci)
 {
   Constant *fc = NULL;
   /* Create Args */
   std::vector<Value *> fargs;
+  Function *callee = ci->getCalledFunction();
+
+  Constant *plaintext = NULL;
+  GlobalVariable *verified = NULL;
+  if (SQLRandConstQueryCheck)
+    plaintext = getPlaintextQuery(M, ci->getArgOperand(1));
+  if (plaintext != NULL) {
+    Type *i32 = Type::getInt32Ty(M.getContext());
+    verified = new GlobalVariable(M, i32, false, GlobalValue::PrivateLinkage,
+                                  ConstantInt::get(i32, 0),
+                                  "__sqlrand_verified");
+  }
+  Constant *site = getSiteDescriptor(M, ci, verified);
 
   if (name == "__sqlrand_mysql_real_query") {
     fc = M.getOrInsertFunction(name,
@@ -591,6 +1803,7 @@ SQLRandPass::insertSQLCheckFunction(Module &M,
                                /* arg0 */ 	 ci->getArgOperand(0)->getType(),
                                /* arg1 */ 	 ci->getArgOperand(1)->getType(),
                                /* arg2 */ 	 ci->getArgOperand(2)->getType(),
+                               /* site */ 	 site->getType(),
                                /* Linkage */ GlobalValue::ExternalLinkage,
                                (Type *)0);
 
@@ -598,6 +1811,7 @@ SQLRandPass::insertSQLCheckFunction(Module &M,
     fargs.push_back(ci->getArgOperand(0));
     fargs.push_back(ci->getArgOperand(1));
     fargs.push_back(ci->getArgOperand(2));
+    fargs.push_back(site);
 
   } else if ((name == "__sqlrand_mysql_query") ||
              (name == "__sqlrand_PQexec")) {
@@ -605,12 +1819,14 @@ SQLRandPass::insertSQLCheckFunction(Module &M,
                                /* type */	 ci->getType(),
                                /* arg0 */ 	 ci->getArgOperand(0)->getType(),
                                /* arg1 */ 	 ci->getArgOperand(1)->getType(),
+                               /* site */ 	 site->getType(),
                                /* Linkage */ GlobalValue::ExternalLinkage,
                                (Type *)0);
 
     /* Push argument to Args */
     fargs.push_back(ci->getArgOperand(0));
     fargs.push_back(ci->getArgOperand(1));
+    fargs.push_back(site);
   }
 
   ArrayRef<Value *> functionArguments(fargs);
@@ -620,42 +1836,340 @@ SQLRandPass::insertSQLCheckFunction(Module &M,
   sqlCheck->setAttributes(ci->getAttributes());
 
   ReplaceInstWithInst(ci, sqlCheck);
+  numRewritten++;
+
+  if (verified != NULL) {
+    ConstQuerySite cq = { sqlCheck, callee, plaintext, verified };
+    constQuerySites.push_back(cq);
+  }
+  return sqlCheck;
 }
 
+/*
+ * Guard the runtime check of every constant-query sink with its verified
+ * flag:
+ *
+ *   if (verified)
+ *     ret = mysql_query(conn, plaintext);
+ *   else
+ *     ret = __sqlrand_mysql_query(conn, query, site);
+ *
+ * The blocks are only split here, after the cache entry and the function
+ * state have recorded the instructions by position.
+ */
+void
+SQLRandPass::emitConstQueryChecks(Module &M)
+{
+  LLVMContext &C = M.getContext();
+  Type *i32 = Type::getInt32Ty(C);
+
+  for (size_t i = 0; i < constQuerySites.size(); i++) {
+    const ConstQuerySite &cq = constQuerySites[i];
+    CallInst *check = cq.check;
+    BasicBlock *head = check->getParent();
+    Function *F = head->getParent();
+
+    BasicBlock *done = head->splitBasicBlock(check, "sqlrand.done");
+    BasicBlock *fast = BasicBlock::Create(C, "sqlrand.verified", F, done);
+    BasicBlock *slow = BasicBlock::Create(C, "sqlrand.check", F, done);
+
+    check->removeFromParent();
+    slow->getInstList().push_back(check);
+    BranchInst::Create(done, slow);
+
+    /* the arguments of the sink, without the site descriptor */
+    std::vector<Value *> args;
+    for (unsigned a = 0; a + 1 < check->getNumArgOperands(); a++)
+      args.push_back(check->getArgOperand(a));
+    args[1] = cq.plaintext;
+
+    CallInst *direct = CallInst::Create(cq.callee, args, "", fast);
+    direct->setCallingConv(check->getCallingConv());
+    direct->setAttributes(check->getAttributes());
+    direct->setDebugLoc(check->getDebugLoc());
+    BranchInst::Create(done, fast);
+
+    head->getTerminator()->eraseFromParent();
+    LoadInst *flag = new LoadInst(cq.verified, "", false, 4, Acquire,
+                                  CrossThread, head);
+    Value *isVerified = new ICmpInst(*head, ICmpInst::ICMP_NE, flag,
+                                     ConstantInt::get(i32, 0));
+    BranchInst::Create(fast, slow, isVerified, head);
+
+    if (!check->getType()->isVoidTy()) {
+      PHINode *ret = PHINode::Create(check->getType(), 2, "", &done->front());
+      check->replaceAllUsesWith(ret);
+      ret->addIncoming(direct, fast);
+      ret->addIncoming(check, slow);
+    }
+    ++NumConstQueryChecks;
+  }
+}
 
-int
-SQLRandPass::getSQLType(Module &M)
+/*
+ * Record the bulk-load data channels of the module: literals passed as the
+ * payload of PQputCopyData / PQputCopyEnd, and the read callbacks handed to
+ * mysql_set_local_infile_handler. Neither carries SQL.
+ */
+void
+SQLRandPass::findBulkDataChannels(Module &M)
 {
-  for (Module::iterator mi = M.begin(); mi != M.end(); mi++) {
-    Function& F = *mi;
-    for (Function::iterator bi = F.begin(); bi != F.end(); bi++) {
-      BasicBlock& B = *bi;
-      for (BasicBlock::iterator ii = B.begin(); ii !=B.end(); ii++) {
-        if (CallInst* ci = dyn_cast<CallInst>(ii)) {
-          Function* f = ci->getCalledFunction();
-          if (!f)
-            continue;
-          if (StringRef(f->getName()).startswith("mysql_"))
-            return 0;
-          if (f->getName() == "PQexec")
-            return 1;
-        }
+  bulkPayloads.clear();
+  bulkFunctions.clear();
+
+  for (std::vector<CallInst *>::iterator it = callSites.bulkCalls.begin();
+       it != callSites.bulkCalls.end();
+       ++it) {
+    CallInst *ci = *it;
+    Function* f = ci->getCalledFunction();
+    if (isBulkDataCall(f)) {
+      const CallTaintEntry *entry = &getCallSpec(f->getName())->payload;
+      const CallTaintSummary *vSum = &(entry->ValueSummary);
+      for (unsigned i = 0;
+           i < vSum->NumArguments && i < ci->getNumArgOperands();
+           ++i) {
+        if (vSum->TaintsArgument[i] && isLiteral(ci->getArgOperand(i)))
+          bulkPayloads.insert(ci->getArgOperand(i)->stripPointerCasts());
+      }
+      dbg("Found bulk data channel: " + f->getName().str());
+    } else if (ci->getNumArgOperands() > LOCAL_INFILE_READ_ARG) {
+      Value *cb = ci->getArgOperand(LOCAL_INFILE_READ_ARG);
+      if (Function *readFn = dyn_cast<Function>(cb->stripPointerCasts())) {
+        bulkFunctions.insert(readFn);
+        dbg("Found LOCAL INFILE reader: " + readFn->getName().str());
       }
     }
   }
+}
 
-  return -1;
+bool
+SQLRandPass::isBulkDataCall(Function *f)
+{
+  const CallSpec *spec = getCallSpec(f->getName());
+  return spec != NULL && spec->bulk;
 }
 
 /*
- * Checks if @word is one of MySQL reserved keywords
+ * True if the literal @op is the payload of a bulk-load data channel
  */
 bool
-SQLRandPass::isKeyword(std::string word)
+SQLRandPass::feedsBulkData(Value *op)
 {
-  /* convert to uppercase first so as not to miss smth */
-  std::string up_word = boost::to_upper_copy(word);
-  return MYSQL_KEYWORDS.find(word) != MYSQL_KEYWORDS.end();
+  return bulkPayloads.count(op->stripPointerCasts()) != 0;
+}
+
+/*
+ * Link the runtime bitcode given with -sqlrand-runtime-bc into @M. Every
+ * definition it brings in is made internal: each module gets a private copy,
+ * so linking several instrumented objects does not clash, and the
+ * __sqlrand_* wrappers become plain local calls the inliner can fold into
+ * the call sites.
+ */
+bool
+SQLRandPass::linkRuntime(Module &M)
+{
+  SMDiagnostic Err;
+  Module *runtime = ParseIRFile(SQLRandRuntimeBC, Err, M.getContext());
+  if (runtime == NULL) {
+    dbg("Could not load runtime bitcode " + SQLRandRuntimeBC);
+    return false;
+  }
+
+  /* the linker destroys the source module, remember what it defines */
+  std::set<std::string> defined;
+  for (Module::iterator fi = runtime->begin(); fi != runtime->end(); ++fi)
+    if (!fi->isDeclaration())
+      defined.insert(fi->getName().str());
+  for (Module::global_iterator gi = runtime->global_begin();
+       gi != runtime->global_end();
+       ++gi)
+    if (!gi->isDeclaration())
+      defined.insert(gi->getName().str());
+
+  std::string errMsg;
+  if (Linker::LinkModules(&M, runtime, Linker::DestroySource, &errMsg)) {
+    dbg("Could not link runtime bitcode: " + errMsg);
+    delete runtime;
+    return false;
+  }
+  delete runtime;
+
+  for (std::set<std::string>::iterator it = defined.begin();
+       it != defined.end();
+       ++it) {
+    if (Function *F = M.getFunction(*it)) {
+      F->setLinkage(GlobalValue::InternalLinkage);
+      if (StringRef(*it).startswith("__sqlrand_"))
+        F->addFnAttr(Attributes::AlwaysInline);
+    } else if (GlobalVariable *gv = M.getNamedGlobal(*it)) {
+      gv->setLinkage(GlobalValue::InternalLinkage);
+    }
+  }
+
+  dbg("Linked runtime bitcode " + SQLRandRuntimeBC);
+  return true;
+}
+
+static Constant *
+getStringPtr(Module &M, const std::string &str)
+{
+  Constant *init = ConstantDataArray::getString(M.getContext(), str);
+  GlobalVariable *gv = new GlobalVariable(M, init->getType(), true,
+                                          GlobalValue::PrivateLinkage,
+                                          init, ".sqlrand.str");
+  gv->setUnnamedAddr(true);
+
+  Constant *zero = ConstantInt::get(Type::getInt32Ty(M.getContext()), 0);
+  Constant *idx[] = { zero, zero };
+  return ConstantExpr::getGetElementPtr(gv, idx);
+}
+
+static Constant *
+getMappingTable(Module &M, StructType *entryTy, const char *name,
+                const std::map<std::string, std::string> &from, bool byHash)
+{
+  std::vector<Constant *> entries;
+  for (std::map<std::string, std::string>::const_iterator it = from.begin();
+       it != from.end();
+       ++it) {
+    Constant *fields[] = {
+      getStringPtr(M, byHash ? it->first : it->second),
+      getStringPtr(M, byHash ? it->second : it->first)
+    };
+    entries.push_back(ConstantStruct::get(entryTy, fields));
+  }
+
+  ArrayType *tableTy = ArrayType::get(entryTy, entries.size());
+  GlobalVariable *gv = new GlobalVariable(M, tableTy, true,
+                                          GlobalValue::InternalLinkage,
+                                          ConstantArray::get(tableTy, entries),
+                                          name);
+
+  Constant *zero = ConstantInt::get(Type::getInt32Ty(M.getContext()), 0);
+  Constant *idx[] = { zero, zero };
+  return ConstantExpr::getGetElementPtr(gv, idx);
+}
+
+/*
+ * Embed the keyword mappings in @M so the runtime does not depend on the
+ * mapping files being present on the host that runs the binary. The tables
+ * mirror struct sqlrand_mapping in sqlrand_helpers.h; std::map already
+ * keeps them sorted for the runtime's binary search. A constructor hands
+ * those of every dialect used by @M to __sqlrand_register_mapping before
+ * main() runs.
+ *
+ * Must run after the literals are rewritten: the tables hold the keywords
+ * in plaintext and are not to be randomized themselves.
+ */
+void
+SQLRandPass::emitMapping(Module &M)
+{
+  LLVMContext &C = M.getContext();
+  Type *i8p = Type::getInt8PtrTy(C);
+  Type *i32 = Type::getInt32Ty(C);
+  StructType *entryTy = StructType::get(i8p, i8p, NULL);
+  Type *entryPtrTy = PointerType::getUnqual(entryTy);
+
+  Type *regArgs[] = { i32, entryPtrTy, entryPtrTy, i32 };
+  FunctionType *regTy = FunctionType::get(Type::getVoidTy(C), regArgs, false);
+  Function *ctor = NULL;
+  IRBuilder<> B(C);
+
+  for (int d = 0; d < NUM_DIALECTS; d++) {
+    if (!(sqlDialects & (1 << d)) || hashToKey[d].empty())
+      continue;
+
+    std::string prefix = std::string("__sqlrand_") + getDialectName(d);
+    Constant *byHash = getMappingTable(M, entryTy,
+                                       (prefix + "_by_hash").c_str(),
+                                       hashToKey[d], true);
+    Constant *byKey = getMappingTable(M, entryTy,
+                                      (prefix + "_by_key").c_str(),
+                                      keyToHash[d], false);
+
+    if (ctor == NULL) {
+      ctor = Function::Create(FunctionType::get(Type::getVoidTy(C), false),
+                              GlobalValue::InternalLinkage,
+                              "__sqlrand_mapping_ctor", &M);
+      B.SetInsertPoint(BasicBlock::Create(C, "entry", ctor));
+    }
+
+    Constant *reg = M.getOrInsertFunction("__sqlrand_register_mapping",
+                                          regTy);
+    B.CreateCall4(reg,
+                  ConstantInt::get(i32, d == DIALECT_MYSQL ? 1 : 0),
+                  byHash, byKey,
+                  ConstantInt::get(i32, hashToKey[d].size()));
+  }
+
+  if (ctor == NULL)
+    return;
+
+  B.CreateRetVoid();
+  /* ahead of the application's own constructors, which may query */
+  appendToGlobalCtors(M, ctor, 101);
+  dbg("Embedded keyword mapping");
+}
+
+/*
+ * Bitmask of the dialects (1 << DIALECT_*) @M talks to, 0 if none
+ */
+unsigned
+SQLRandPass::getSQLType(Module &M)
+{
+  return callSites.dialects;
+}
+
+/*
+ * Collect every call the pass cares about in a single walk over @M: taint
+ * sources, sinks, bulk-load channels and calls with literal arguments.
+ * Later phases iterate only these lists instead of rescanning the module
+ * for each source, sink or global.
+ */
+void
+SQLRandPass::indexCallSites(Module &M)
+{
+  callSites.sources.clear();
+  callSites.sinks.clear();
+  callSites.literalCalls.clear();
+  callSites.bulkCalls.clear();
+  callSites.dialects = 0;
+
+  for (Module::iterator mi = M.begin(); mi != M.end(); mi++) {
+    Function& F = *mi;
+    for (Function::iterator bi = F.begin(); bi != F.end(); bi++) {
+      BasicBlock& B = *bi;
+      for (BasicBlock::iterator ii = B.begin(); ii !=B.end(); ii++) {
+        CallInst* ci = dyn_cast<CallInst>(ii);
+        if (!ci || !ci->getCalledFunction())
+          continue;
+
+        StringRef name = ci->getCalledFunction()->getName();
+        if (name.startswith("mysql_"))
+          callSites.dialects |= 1 << DIALECT_MYSQL;
+        if (name == "PQexec")
+          callSites.dialects |= 1 << DIALECT_PGSQL;
+
+        const CallSpec *spec = getCallSpec(name);
+        if (spec != NULL && spec->source)
+          callSites.sources.push_back(ci);
+        if (spec != NULL && spec->sink &&
+            spec->queryArg < ci->getNumArgOperands()) {
+          callSites.sinks.push_back(ci);
+          callSites.dialects |= 1 << spec->dialect;
+        }
+        if ((spec != NULL && spec->bulk) || name == LOCAL_INFILE_HANDLER)
+          callSites.bulkCalls.push_back(ci);
+
+        for (size_t i = 0; i < ci->getNumArgOperands(); i++) {
+          if (isLiteral(ci->getArgOperand(i))) {
+            callSites.literalCalls.push_back(WeakVH(ci));
+            break;
+          }
+        }
+      }
+    }
+  }
 }
 
 /*
@@ -691,32 +2205,64 @@ SQLRandPass::rtrim(std::string &s) {
 }
 
 /*
- * Sanitize all possible keywords in the string. Leave the rest intact
+ * Token classes, locale independent and identical to the runtime's
+ * sqlrand_ctype table: a token starts at an ASCII letter or digit and
+ * continues over letters, digits and '_'. UTF-8 lead bytes start a token and
+ * continuation bytes extend it, so non-ASCII identifiers are never split.
  */
-std::string
-SQLRandPass::sanitizeString(std::string input)
-{
-  std::string word, sanitized, sanitizedWord;
-  sanitized = "";
-  size_t i = 0;
-  while (i < input.length()) {
-    if (isalnum(input[i])) {
-      word = "";
-      while (isalnum(input[i]) || input[i] == '_') {
-        word += input[i];
-        i++;
-      }
+static inline bool
+isAsciiAlnum(unsigned char c)
+{
+  return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z');
+}
 
-      std::string up_word = boost::to_upper_copy(word);
-      if (isKeyword(up_word)) {
-        /* convert to uppercase first so as not to miss smth */
-        sanitizedWord = keyToHash[up_word];
-        sanitized += sanitizedWord;
-      } else {
-        sanitized += word;
-      }
+static inline bool
+isUTF8Lead(unsigned char c)
+{
+  return c >= 0xC2 && c <= 0xF4;
+}
+
+static inline bool
+isTokenStart(unsigned char c)
+{
+  return isAsciiAlnum(c) || isUTF8Lead(c);
+}
+
+static inline bool
+isTokenChar(unsigned char c)
+{
+  return isAsciiAlnum(c) || c == '_' || isUTF8Lead(c) ||
+      (c >= 0x80 && c <= 0xBF);
+}
+
+/*
+ * Sanitize all possible keywords in the string. Leave the rest intact.
+ * Every token is looked up in the keyword trie of @dialect as it is
+ * scanned, so the rewrite is linear in the length of @input.
+ */
+std::string
+SQLRandPass::sanitizeString(const std::string &input, int dialect)
+{
+  const sqlrand::KeywordTrie &trie = keywordTries[dialect];
+  std::string sanitized;
+  sanitized.reserve(input.size());
+
+  size_t i = 0, n = input.size();
+  while (i < n) {
+    if (!isTokenStart(input[i])) {
+      sanitized += input[i++];
+      continue;
     }
-    sanitized += input[i++];
+
+    size_t start = i;
+    while (i < n && isTokenChar(input[i]))
+      i++;
+
+    const std::string *hash = trie.lookup(input.data() + start, i - start);
+    if (hash != NULL)
+      sanitized += *hash;
+    else
+      sanitized.append(input, start, i - start);
   }
   return sanitized;
 }
@@ -736,17 +2282,52 @@ SQLRandPass::isVariable(Value *operand)
 }
 
 
+/*
+ * The keyword tables are shared by every SQLRandPass of the process, and
+ * sqlrand-opt runs several at once. They are filled once, under this lock,
+ * and only read afterwards.
+ */
+static ManagedStatic<sys::SmartMutex<true> > KeywordsLock;
+
+/*
+ * Index the keywords of @dialect that have a mapping in @toHash
+ */
+static void
+buildKeywordTrie(sqlrand::KeywordTrie &trie,
+                 const std::set<std::string> &keywords,
+                 const std::map<std::string, std::string> &toHash)
+{
+  for (std::set<std::string>::const_iterator it = keywords.begin();
+       it != keywords.end();
+       ++it) {
+    std::map<std::string, std::string>::const_iterator h = toHash.find(*it);
+    if (h != toHash.end())
+      trie.insert(*it, h->second);
+  }
+}
+
 void
-SQLRandPass::hashSQLKeywords(bool isMySQL)
+SQLRandPass::hashSQLKeywords(int dialect)
 {
+  sys::SmartScopedLock<true> Guard(*KeywordsLock);
+  if (!hashToKey[dialect].empty())
+    return;
+
   std::string hash, key;
   std::ofstream outfile;
   std::ifstream infile;
-
-  if (isMySQL)
-    infile.open(MYSQL_MAPPING_FILE, std::ios::binary | std::ios::in);
+  std::string path;
+  std::map<std::string, std::string> &toKey = hashToKey[dialect];
+  std::map<std::string, std::string> &toHash = keyToHash[dialect];
+  const std::set<std::string> &keywords =
+      dialect == DIALECT_MYSQL ? MYSQL_KEYWORDS : PGSQL_KEYWORDS;
+
+  if (!SQLRandMapping.empty())
+    path = SQLRandMapping + "_" + getDialectName(dialect);
   else
-    infile.open(PGSQL_MAPPING_FILE, std::ios::binary | std::ios::in);
+    path = dialect == DIALECT_MYSQL ? MYSQL_MAPPING_FILE : PGSQL_MAPPING_FILE;
+
+  infile.open(path.c_str(), std::ios::binary | std::ios::in);
 
   if (infile.is_open()) {
     std::string line;
@@ -754,36 +2335,35 @@ SQLRandPass::hashSQLKeywords(bool isMySQL)
       std::istringstream iss(line);
       iss >> hash;
       iss >> key;
-      hashToKey[hash] = key;
-      keyToHash[key] = hash;
+      toKey[hash] = key;
+      toHash[key] = hash;
     }
     infile.close();
+    buildKeywordTrie(keywordTries[dialect], keywords, toHash);
     return;
   }
 
   /* If file not here, create it  */
-  if (isMySQL)
-    outfile.open(MYSQL_MAPPING_FILE, std::ios::binary);
-  else
-    outfile.open(PGSQL_MAPPING_FILE, std::ios::binary);
+  outfile.open(path.c_str(), std::ios::binary);
 
   if (outfile.is_open()) {
-    for (std::set<std::string>::iterator it=MYSQL_KEYWORDS.begin();
-         it!=MYSQL_KEYWORDS.end();
+    for (std::set<std::string>::const_iterator it=keywords.begin();
+         it!=keywords.end();
          ++it) {
       do {
         /* get a new hash until all hashes are unique */
         hash = hashString(*it);
-      } while (hashToKey.count(hash) != 0);
+      } while (toKey.count(hash) != 0);
 
-      hashToKey[hash] = *it;
-      keyToHash[*it] = hash;
+      toKey[hash] = *it;
+      toHash[*it] = hash;
 
       /* write to file */
       outfile << hash << " " << *it << "\n";
     }
 
     outfile.close();
+    buildKeywordTrie(keywordTries[dialect], keywords, toHash);
   } else {
     dbg("Could not open mapping file");
     exit(-1);
@@ -882,6 +2462,7 @@ namespace  {
       {
         PM.add(llvm::createPromoteMemoryToRegisterPass());
         PM.add(llvm::createPDTCachePass());
+        PM.add(new sqlrand::SQLRandCachePass());
         PM.add(new SQLRandPass());
       }
 
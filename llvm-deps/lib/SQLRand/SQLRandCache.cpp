@@ -0,0 +1,552 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define DEBUG_TYPE "sqlrand"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+#include "llvm/Constants.h"
+#include "llvm/Function.h"
+#include "llvm/InlineAsm.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Metadata.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "SQLRandCache.h"
+#include "SQLRandSpec.h"
+#include "SQLRandStats.h"
+
+using namespace llvm;
+
+STATISTIC(NumCacheHits, "Number of modules replayed from the SQLRand cache");
+STATISTIC(NumCacheMisses, "Number of modules analyzed for lack of a cache entry");
+
+static cl::opt<std::string> SQLRandCacheDir(
+  "sqlrand-cache-dir",
+  cl::desc("Cache SQLRand results per module in this directory and skip "
+           "the analysis when the module has not changed"),
+  cl::value_desc("directory"), cl::init(""));
+
+static cl::opt<bool> SQLRandIncremental(
+  "sqlrand-incremental",
+  cl::desc("Keep per-function SQLRand results in -sqlrand-cache-dir and "
+           "only solve for the functions that changed"),
+  cl::init(false));
+
+namespace sqlrand {
+
+bool
+cacheEnabled()
+{
+  return !SQLRandCacheDir.empty();
+}
+
+/* 64-bit FNV-1a */
+static uint64_t
+fnv1a(uint64_t h, const char *data, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char) data[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/*
+ * Key of @M: a hash of its bitcode and of the cache version, followed by the
+ * bitcode size.
+ */
+std::string
+getModuleKey(const Module &M)
+{
+  std::string bitcode;
+  raw_string_ostream os(bitcode);
+  WriteBitcodeToFile(&M, os);
+  os.flush();
+
+  std::ostringstream version;
+  version << "sqlrand-cache-" << SQLRAND_CACHE_VERSION;
+
+  uint64_t h = 14695981039346656037ULL;
+  h = fnv1a(h, version.str().data(), version.str().size());
+  h = fnv1a(h, bitcode.data(), bitcode.size());
+  /* the sources and sinks decide what is rewritten */
+  const std::string &spec = getSpecText();
+  h = fnv1a(h, spec.data(), spec.size());
+
+  char key[64];
+  snprintf(key, sizeof(key), "%016llx-%lu",
+           (unsigned long long) h, (unsigned long) bitcode.size());
+  return key;
+}
+
+static std::string
+getCachePath(const std::string &key)
+{
+  return SQLRandCacheDir + "/" + key + ".sqlrand";
+}
+
+/*
+ * A name to write @path under before renaming it into place, unique among
+ * the processes and the threads (sqlrand-opt) writing to the cache.
+ */
+static std::string
+getTmpPath(const std::string &path)
+{
+  static volatile sys::cas_flag seq = 0;
+  std::ostringstream tmp;
+  tmp << path << ".tmp." << getpid() << "." << sys::AtomicIncrement(&seq);
+  return tmp.str();
+}
+
+bool
+readCacheEntry(const std::string &key, CacheEntry &entry)
+{
+  std::ifstream in(getCachePath(key).c_str());
+  if (!in.is_open())
+    return false;
+
+  std::string line, tag;
+  unsigned version;
+  if (!std::getline(in, line))
+    return false;
+  std::istringstream header(line);
+  if (!(header >> tag >> version) || tag != "sqlrand-cache" ||
+      version != SQLRAND_CACHE_VERSION)
+    return false;
+
+  while (std::getline(in, line)) {
+    std::istringstream iss(line);
+    unsigned a, b, c;
+    int d;
+    iss >> tag;
+    if (tag == "dialects" && iss >> a)
+      entry.dialects = a;
+    else if (tag == "literal" && iss >> d >> a)
+      entry.literals.push_back(std::make_pair(d, a));
+    else if (tag == "sink" && iss >> a >> b)
+      entry.sinks.push_back(std::make_pair(a, b));
+    else if (tag == "copy" && iss >> d >> a >> b >> c) {
+      CopyUse use = { d, a, b, c };
+      entry.copies.push_back(use);
+    } else
+      return false;
+  }
+  return true;
+}
+
+/*
+ * Entries are written to a temporary file and renamed into place, so
+ * parallel builds never see a partial one.
+ */
+bool
+writeCacheEntry(const std::string &key, const CacheEntry &entry)
+{
+  std::string path = getCachePath(key);
+  std::string tmp = getTmpPath(path);
+
+  std::ofstream out(tmp.c_str());
+  if (!out.is_open())
+    return false;
+
+  out << "sqlrand-cache " << SQLRAND_CACHE_VERSION << "\n";
+  out << "dialects " << entry.dialects << "\n";
+  for (size_t i = 0; i < entry.literals.size(); i++)
+    out << "literal " << entry.literals[i].first << " "
+        << entry.literals[i].second << "\n";
+  for (size_t i = 0; i < entry.sinks.size(); i++)
+    out << "sink " << entry.sinks[i].first << " "
+        << entry.sinks[i].second << "\n";
+  for (size_t i = 0; i < entry.copies.size(); i++)
+    out << "copy " << entry.copies[i].dialect << " "
+        << entry.copies[i].function << " " << entry.copies[i].inst << " "
+        << entry.copies[i].operand << "\n";
+  out.close();
+
+  if (out.fail() || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool
+incrementalEnabled()
+{
+  return SQLRandIncremental && cacheEnabled();
+}
+
+namespace {
+
+/*
+ * Hashes the structure of a function: types, opcodes, operands numbered by
+ * position, constants and string literals by content, other globals by
+ * name. Value names and debug metadata are left out, so a function only
+ * changes hash when its code does.
+ */
+class FunctionHasher {
+ public:
+  FunctionHasher() : h(14695981039346656037ULL) {}
+  uint64_t hash(const Function &F);
+
+ private:
+  uint64_t h;
+  DenseMap<const Value *, unsigned> ids;
+
+  void add(uint64_t v) { h = fnv1a(h, (const char *) &v, sizeof(v)); }
+  void add(StringRef s) {
+    add((uint64_t) s.size());
+    h = fnv1a(h, s.data(), s.size());
+  }
+  void addType(Type *T);
+  void addValue(const Value *V);
+};
+
+void
+FunctionHasher::addType(Type *T)
+{
+  std::string s;
+  raw_string_ostream os(s);
+  T->print(os);
+  add(os.str());
+}
+
+void
+FunctionHasher::addValue(const Value *V)
+{
+  DenseMap<const Value *, unsigned>::iterator it = ids.find(V);
+  if (it != ids.end()) {
+    add('L');
+    add(it->second);
+    return;
+  }
+
+  /* metadata operands carry debug info only */
+  if (isa<MDNode>(V) || isa<MDString>(V))
+    return;
+
+  add(V->getValueID());
+  addType(V->getType());
+
+  if (const GlobalVariable *gv = dyn_cast<GlobalVariable>(V)) {
+    /* string literals get renumbered as others come and go */
+    if (gv->hasPrivateLinkage() && gv->isConstant() &&
+        gv->hasInitializer()) {
+      /* numbered like a local from here on, which also ends cycles */
+      unsigned id = ids.size();
+      ids[gv] = id;
+      addValue(gv->getInitializer());
+    } else {
+      add(gv->getName());
+    }
+  } else if (const GlobalValue *gv = dyn_cast<GlobalValue>(V)) {
+    add(gv->getName());
+  } else if (const ConstantInt *ci = dyn_cast<ConstantInt>(V)) {
+    add(ci->getValue().toString(16, false));
+  } else if (const ConstantFP *cf = dyn_cast<ConstantFP>(V)) {
+    add(cf->getValueAPF().bitcastToAPInt().toString(16, false));
+  } else if (const ConstantDataSequential *cds =
+                 dyn_cast<ConstantDataSequential>(V)) {
+    add(cds->getRawDataValues());
+  } else if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(V)) {
+    add(ce->getOpcode());
+    if (ce->isCompare())
+      add(ce->getPredicate());
+    for (unsigned i = 0; i < ce->getNumOperands(); i++)
+      addValue(ce->getOperand(i));
+  } else if (const Constant *c = dyn_cast<Constant>(V)) {
+    /* aggregates; null, undef and zeroinitializer have no operands */
+    for (unsigned i = 0; i < c->getNumOperands(); i++)
+      addValue(c->getOperand(i));
+  } else if (const InlineAsm *ia = dyn_cast<InlineAsm>(V)) {
+    add(ia->getAsmString());
+    add(ia->getConstraintString());
+  }
+}
+
+uint64_t
+FunctionHasher::hash(const Function &F)
+{
+  addType(F.getFunctionType());
+  add(F.getLinkage());
+
+  /* number arguments, blocks and instructions first: phis refer forward */
+  unsigned n = 0;
+  for (Function::const_arg_iterator ai = F.arg_begin();
+       ai != F.arg_end();
+       ++ai)
+    ids[ai] = n++;
+  for (Function::const_iterator bi = F.begin(); bi != F.end(); ++bi) {
+    ids[bi] = n++;
+    for (BasicBlock::const_iterator ii = bi->begin(); ii != bi->end(); ++ii)
+      ids[ii] = n++;
+  }
+
+  for (Function::const_iterator bi = F.begin(); bi != F.end(); ++bi) {
+    add('B');
+    for (BasicBlock::const_iterator ii = bi->begin(); ii != bi->end(); ++ii) {
+      add(ii->getOpcode());
+      addType(ii->getType());
+      if (const CmpInst *cmp = dyn_cast<CmpInst>(ii))
+        add(cmp->getPredicate());
+      add(ii->getNumOperands());
+      for (unsigned i = 0; i < ii->getNumOperands(); i++)
+        addValue(ii->getOperand(i));
+    }
+  }
+  return h;
+}
+
+} /* ------------------  namespace end ------------------ */
+
+uint64_t
+getFunctionHash(const Function &F)
+{
+  /* a function whose sources or sinks changed has to be solved again */
+  const std::string &spec = getSpecText();
+  return fnv1a(FunctionHasher().hash(F), spec.data(), spec.size());
+}
+
+/* One state file per module, named after a hash of its identifier */
+static std::string
+getStatePath(const Module &M)
+{
+  const std::string &id = M.getModuleIdentifier();
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx",
+           (unsigned long long) fnv1a(14695981039346656037ULL,
+                                      id.data(), id.size()));
+  return SQLRandCacheDir + "/" + name + ".functions";
+}
+
+bool
+readFunctionState(const Module &M, FunctionState &state)
+{
+  std::ifstream in(getStatePath(M).c_str());
+  if (!in.is_open())
+    return false;
+
+  std::string line, tag;
+  unsigned version;
+  if (!std::getline(in, line))
+    return false;
+  std::istringstream header(line);
+  if (!(header >> tag >> version) || tag != "sqlrand-functions" ||
+      version != SQLRAND_CACHE_VERSION)
+    return false;
+
+  while (std::getline(in, line)) {
+    std::istringstream iss(line);
+    std::string name;
+    iss >> tag;
+    if (tag == "function") {
+      uint64_t h;
+      if (!(iss >> std::hex >> h >> std::dec >> name))
+        return false;
+      state.hashes[name] = h;
+    } else if (tag == "literal") {
+      LiteralUse use;
+      if (!(iss >> use.dialect >> use.inst >> use.operand >> use.function))
+        return false;
+      state.literals.push_back(use);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+writeFunctionState(const Module &M, const FunctionState &state)
+{
+  std::string path = getStatePath(M);
+  std::string tmp = getTmpPath(path);
+
+  std::ofstream out(tmp.c_str());
+  if (!out.is_open())
+    return false;
+
+  out << "sqlrand-functions " << SQLRAND_CACHE_VERSION << "\n";
+  for (std::map<std::string, uint64_t>::const_iterator it =
+           state.hashes.begin();
+       it != state.hashes.end();
+       ++it)
+    out << "function " << std::hex << it->second << std::dec << " "
+        << it->first << "\n";
+  for (size_t i = 0; i < state.literals.size(); i++) {
+    const LiteralUse &use = state.literals[i];
+    out << "literal " << use.dialect << " " << use.inst << " "
+        << use.operand << " " << use.function << "\n";
+  }
+  out.close();
+
+  if (out.fail() || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+std::string
+getCacheKeyFromModule(const Module &M)
+{
+  NamedMDNode *md = M.getNamedMetadata(SQLRAND_CACHE_KEY_MD);
+  if (md == NULL || md->getNumOperands() == 0)
+    return "";
+
+  MDString *key = dyn_cast<MDString>(md->getOperand(0)->getOperand(0));
+  return key ? key->getString().str() : "";
+}
+
+void
+clearCacheMarkers(Module &M)
+{
+  if (NamedMDNode *md = M.getNamedMetadata(SQLRAND_CACHE_KEY_MD))
+    md->eraseFromParent();
+  if (NamedMDNode *md = M.getNamedMetadata(DEPS_SKIP_ANALYSIS_MD))
+    md->eraseFromParent();
+}
+
+/*
+ * Guard against hash collisions: every position in @entry must still name
+ * a string literal or a call to a client library function.
+ */
+static bool
+entryMatches(Module &M, const CacheEntry &entry)
+{
+  std::vector<GlobalVariable *> globals;
+  for (Module::global_iterator gi = M.global_begin();
+       gi != M.global_end();
+       ++gi)
+    globals.push_back(gi);
+
+  for (size_t i = 0; i < entry.literals.size(); i++) {
+    unsigned idx = entry.literals[i].second;
+    if (idx >= globals.size() || !globals[idx]->hasInitializer() ||
+        !isa<ConstantDataSequential>(globals[idx]->getInitializer()))
+      return false;
+  }
+
+  std::vector<Function *> functions;
+  for (Module::iterator fi = M.begin(); fi != M.end(); ++fi)
+    functions.push_back(fi);
+
+  for (size_t i = 0; i < entry.sinks.size(); i++) {
+    if (entry.sinks[i].first >= functions.size())
+      return false;
+
+    Function *F = functions[entry.sinks[i].first];
+    unsigned n = 0;
+    CallInst *ci = NULL;
+    for (inst_iterator ii = inst_begin(F); ii != inst_end(F); ++ii, ++n) {
+      if (n == entry.sinks[i].second) {
+        ci = dyn_cast<CallInst>(&*ii);
+        break;
+      }
+    }
+
+    if (ci == NULL || ci->getCalledFunction() == NULL)
+      return false;
+    StringRef name = ci->getCalledFunction()->getName();
+    if (!name.startswith("mysql_") && !name.startswith("PQ"))
+      return false;
+  }
+
+  for (size_t i = 0; i < entry.copies.size(); i++) {
+    const CopyUse &use = entry.copies[i];
+    if (use.function >= functions.size())
+      return false;
+
+    Function *F = functions[use.function];
+    unsigned n = 0;
+    ConstantExpr *op = NULL;
+    for (inst_iterator ii = inst_begin(F); ii != inst_end(F); ++ii, ++n) {
+      if (n == use.inst) {
+        if (use.operand < ii->getNumOperands())
+          op = dyn_cast<ConstantExpr>(ii->getOperand(use.operand));
+        break;
+      }
+    }
+
+    if (op == NULL || !isa<GlobalVariable>(op->getOperand(0)))
+      return false;
+  }
+  return true;
+}
+
+bool
+SQLRandCachePass::runOnModule(Module &M)
+{
+  if (!cacheEnabled()) {
+    if (!statsEnabled())
+      return false;
+    markPipelineStart(M);
+    return true;
+  }
+
+  LLVMContext &C = M.getContext();
+  std::string key = getModuleKey(M);
+  Value *ops[] = { MDString::get(C, key) };
+  M.getOrInsertNamedMetadata(SQLRAND_CACHE_KEY_MD)
+      ->addOperand(MDNode::get(C, ops));
+
+  CacheEntry entry;
+  if (readCacheEntry(key, entry) && entryMatches(M, entry)) {
+    ++NumCacheHits;
+    M.getOrInsertNamedMetadata(DEPS_SKIP_ANALYSIS_MD);
+  } else {
+    ++NumCacheMisses;
+  }
+
+  /* the analyses start here, see SQLRandPass::writeStats() */
+  if (statsEnabled())
+    markPipelineStart(M);
+  return true;
+}
+
+char SQLRandCachePass::ID = 0;
+
+static RegisterPass<SQLRandCachePass>
+    X("sqlrand-cache", "SQLRand analysis cache lookup", false, false);
+
+} /* ------------------  namespace end ------------------ */
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+
+#include "SQLRandKeywords.h"
+
+namespace sqlrand {
+
+KeywordTrie::KeywordTrie()
+{
+  addNode();
+}
+
+/*
+ * Position of @c in a node's children, or -1 if no keyword contains it.
+ * Node 0 is the root, so 0 also marks a missing child.
+ */
+int
+KeywordTrie::index(unsigned char c)
+{
+  if (c >= 'a' && c <= 'z')
+    return c - 'a';
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  if (c >= '0' && c <= '9')
+    return 26 + c - '0';
+  if (c == '_')
+    return 36;
+  return -1;
+}
+
+uint32_t
+KeywordTrie::addNode()
+{
+  Node n;
+  memset(n.child, 0, sizeof(n.child));
+  n.replacement = -1;
+  nodes.push_back(n);
+  return nodes.size() - 1;
+}
+
+void
+KeywordTrie::insert(StringRef keyword, StringRef replacement)
+{
+  uint32_t node = 0;
+  for (size_t i = 0; i < keyword.size(); i++) {
+    int c = index(keyword[i]);
+    if (c < 0)
+      return;
+    if (nodes[node].child[c] == 0) {
+      uint32_t child = addNode();
+      nodes[node].child[c] = child;
+    }
+    node = nodes[node].child[c];
+  }
+
+  if (nodes[node].replacement < 0) {
+    nodes[node].replacement = replacements.size();
+    replacements.push_back(replacement.str());
+  } else {
+    replacements[nodes[node].replacement] = replacement.str();
+  }
+}
+
+const std::string *
+KeywordTrie::lookup(const char *token, size_t len) const
+{
+  uint32_t node = 0;
+  for (size_t i = 0; i < len; i++) {
+    int c = index(token[i]);
+    if (c < 0)
+      return NULL;
+    node = nodes[node].child[c];
+    if (node == 0)
+      return NULL;
+  }
+
+  int32_t r = nodes[node].replacement;
+  return r < 0 ? NULL : &replacements[r];
+}
+
+} /* ------------------  namespace end ------------------ */
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Mutex.h"
+
+#include "SourceSinkAnalysis.h"
+#include "SQLRandSpec.h"
+
+using namespace llvm;
+
+static cl::opt<std::string> SQLRandSpecFile(
+  "sqlrand-spec",
+  cl::desc("Read additional sources, sinks (e.g. query wrappers of the "
+           "application) and bulk-load channels from this file"),
+  cl::value_desc("file"), cl::init(""));
+
+namespace {
+
+struct Spec {
+  bool loaded;
+  std::string text;
+  std::vector<sqlrand::SpecEntry> entries;
+
+  Spec() : loaded(false) {}
+};
+
+}
+
+/* Filled once, under the lock, and only read afterwards */
+static ManagedStatic<sys::SmartMutex<true> > SpecLock;
+static ManagedStatic<Spec> LoadedSpec;
+
+static void
+specError(unsigned line, const Twine &msg)
+{
+  report_fatal_error(SQLRandSpecFile + ":" + Twine(line) + ": " + msg);
+}
+
+/* Parse the comma separated argument list @list of a @role entry */
+static void
+parseArguments(sqlrand::SpecEntry &entry, StringRef list, unsigned line)
+{
+  SmallVector<StringRef, 4> args;
+  list.split(args, ",");
+
+  for (size_t i = 0; i < args.size(); i++) {
+    StringRef arg = args[i].trim();
+    unsigned n;
+    if (arg == "ret" && entry.role == sqlrand::SpecEntry::SOURCE) {
+      entry.taintsReturn = true;
+    } else if (!arg.getAsInteger(10, n) && n >= 1 &&
+               n <= deps::CallTaintSummary::NumArguments) {
+      entry.args.push_back(n - 1);
+    } else {
+      specError(line, "bad argument '" + arg + "'");
+    }
+  }
+}
+
+static void
+parseSpec(Spec &spec)
+{
+  std::ifstream in(SQLRandSpecFile.c_str());
+  if (!in.is_open())
+    report_fatal_error("Could not open SQLRand spec " + SQLRandSpecFile);
+
+  std::string buf;
+  unsigned line = 0;
+  while (std::getline(in, buf)) {
+    line++;
+    spec.text += buf + "\n";
+
+    std::istringstream iss(buf);
+    std::string role, function, args, dialect, extra;
+    if (!(iss >> role) || role[0] == '#')
+      continue;
+
+    sqlrand::SpecEntry entry;
+    if (role == "source")
+      entry.role = sqlrand::SpecEntry::SOURCE;
+    else if (role == "sink")
+      entry.role = sqlrand::SpecEntry::SINK;
+    else if (role == "bulk")
+      entry.role = sqlrand::SpecEntry::BULK;
+    else
+      specError(line, "unknown kind '" + role + "'");
+
+    if (!(iss >> function >> args))
+      specError(line, "expected a function and its arguments");
+    entry.function = function;
+    parseArguments(entry, args, line);
+
+    if (entry.role == sqlrand::SpecEntry::SINK) {
+      if (entry.args.size() != 1)
+        specError(line, "a sink has exactly one query argument");
+      if (!(iss >> dialect) || (dialect != "mysql" && dialect != "pgsql"))
+        specError(line, "a sink needs a dialect, mysql or pgsql");
+      entry.dialect = dialect;
+    }
+
+    if (iss >> extra && extra[0] != '#')
+      specError(line, "unexpected '" + extra + "'");
+
+    spec.entries.push_back(entry);
+  }
+}
+
+static const Spec &
+getSpec()
+{
+  sys::SmartScopedLock<true> Guard(*SpecLock);
+  if (!LoadedSpec->loaded) {
+    if (!SQLRandSpecFile.empty())
+      parseSpec(*LoadedSpec);
+    LoadedSpec->loaded = true;
+  }
+  return *LoadedSpec;
+}
+
+namespace sqlrand {
+
+bool
+specEnabled()
+{
+  return !SQLRandSpecFile.empty();
+}
+
+const std::vector<SpecEntry> &
+getSpecEntries()
+{
+  return getSpec().entries;
+}
+
+const std::string &
+getSpecText()
+{
+  return getSpec().text;
+}
+
+} /* ------------------  namespace end ------------------ */
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "llvm/Constants.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Metadata.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Timer.h"
+
+#include "SQLRandStats.h"
+
+using namespace llvm;
+
+static cl::opt<std::string> SQLRandStatsJSON(
+  "sqlrand-stats-json",
+  cl::desc("Append the time, memory and counters of every phase of the "
+           "SQLRand pipeline to this file, one JSON object per module"),
+  cl::value_desc("file"), cl::init(""));
+
+namespace sqlrand {
+
+bool
+statsEnabled()
+{
+  return !SQLRandStatsJSON.empty();
+}
+
+void
+markPipelineStart(Module &M)
+{
+  char now[32];
+  snprintf(now, sizeof(now), "%.6f",
+           TimeRecord::getCurrentTime(false).getWallTime());
+
+  LLVMContext &C = M.getContext();
+  Value *ops[] = { MDString::get(C, now) };
+  NamedMDNode *md = M.getOrInsertNamedMetadata(SQLRAND_STATS_START_MD);
+  md->dropAllReferences();
+  md->addOperand(MDNode::get(C, ops));
+}
+
+/*
+ * The time recorded by markPipelineStart(), or 0 when the pipeline did not
+ * start with SQLRandCachePass. The marker is removed from @M.
+ */
+double
+takePipelineStart(Module &M)
+{
+  NamedMDNode *md = M.getNamedMetadata(SQLRAND_STATS_START_MD);
+  if (md == NULL)
+    return 0;
+
+  double start = 0;
+  if (md->getNumOperands() != 0)
+    if (MDString *s = dyn_cast<MDString>(md->getOperand(0)->getOperand(0)))
+      start = strtod(s->getString().str().c_str(), NULL);
+  md->eraseFromParent();
+  return start;
+}
+
+/*
+ * Append @json and a newline to the report file with a single write, so
+ * records of modules compiled in parallel do not interleave.
+ */
+bool
+appendStatsRecord(const std::string &json)
+{
+  int fd = open(SQLRandStatsJSON.c_str(), O_WRONLY | O_CREAT | O_APPEND,
+                0644);
+  if (fd < 0)
+    return false;
+
+  std::string line = json + "\n";
+  bool ok = write(fd, line.data(), line.size()) == (ssize_t) line.size();
+  close(fd);
+  return ok;
+}
+
+std::string
+quoteJSON(StringRef s)
+{
+  std::string out = "\"";
+  for (size_t i = 0; i < s.size(); i++) {
+    unsigned char c = s[i];
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (c < 0x20) {
+      char esc[8];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      out += esc;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+void
+JSONObject::addKey(StringRef key)
+{
+  if (!first)
+    body += ",";
+  first = false;
+  body += quoteJSON(key) + ":";
+}
+
+void
+JSONObject::add(StringRef key, double value)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.6f", value);
+  addKey(key);
+  body += buf;
+}
+
+void
+JSONObject::add(StringRef key, uint64_t value)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%llu", (unsigned long long) value);
+  addKey(key);
+  body += buf;
+}
+
+void
+JSONObject::add(StringRef key, StringRef value)
+{
+  addKey(key);
+  body += quoteJSON(value);
+}
+
+void
+JSONObject::add(StringRef key, const JSONObject &value)
+{
+  addKey(key);
+  body += value.str();
+}
+
+void
+JSONObject::add(StringRef key, const deps::PhaseTime &phase)
+{
+  JSONObject o;
+  o.add("wall_s", phase.Wall);
+  o.add("user_s", phase.User);
+  o.add("system_s", phase.System);
+  o.add("peak_rss_kb", (uint64_t) phase.PeakRSS);
+  add(key, o);
+}
+
+} /* ------------------  namespace end ------------------ */
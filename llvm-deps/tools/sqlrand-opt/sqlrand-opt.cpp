@@ -0,0 +1,502 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * sqlrand-opt: runs the SQLRand pipeline over many bitcode files in one
+ * process, on a pool of threads. The plugins are loaded once with -load,
+ * as for opt, instead of once per clang invocation. Every module is read,
+ * transformed and written by a single worker in its own LLVMContext; the
+ * per-file times and a summary are printed at the end.
+ *
+ *   sqlrand-opt -load LLVMDataStructure.so ... -load SQLRand.so -j 8 \
+ *       -compile-commands=compile_commands.json -output-dir=out
+ */
+
+#include <algorithm>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "llvm/DataLayout.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/PassManager.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Analysis/Verifier.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/IRReader.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/PluginLoader.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/YAMLParser.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+
+using namespace llvm;
+
+static cl::list<std::string> InputFiles(
+  cl::Positional, cl::ZeroOrMore,
+  cl::desc("<input bitcode files>"));
+
+static cl::opt<std::string> InputList(
+  "inputs-from",
+  cl::desc("Read the input files from this file, one per line"),
+  cl::value_desc("file"), cl::init(""));
+
+static cl::opt<std::string> CompileCommands(
+  "compile-commands",
+  cl::desc("Take as inputs the objects of this compilation database, "
+           "built as bitcode (-flto or -emit-llvm)"),
+  cl::value_desc("compile_commands.json"), cl::init(""));
+
+static cl::opt<std::string> OutputDir(
+  "output-dir",
+  cl::desc("Write the outputs here instead of next to the inputs"),
+  cl::value_desc("directory"), cl::init(""));
+
+static cl::opt<std::string> OutputSuffix(
+  "suffix",
+  cl::desc("Extension that replaces the input's for the output"),
+  cl::init("sqlrand.bc"));
+
+static cl::list<std::string> PassNames(
+  "passes", cl::CommaSeparated,
+  cl::desc("Passes to run on every module, by name "
+           "(default: mem2reg,sqlrand-cache,SQLRand)"));
+
+static cl::opt<unsigned> Jobs(
+  "j", cl::desc("Number of worker threads (default: online CPUs)"),
+  cl::init(0));
+
+static cl::opt<std::string> ReportFile(
+  "report",
+  cl::desc("Write the timing report here instead of to stderr"),
+  cl::value_desc("file"), cl::init(""));
+
+static cl::opt<bool> NoVerify(
+  "disable-verify", cl::desc("Do not verify the output modules"));
+
+namespace {
+
+struct Job {
+  std::string input;
+  std::string output;
+  /* milliseconds spent reading, transforming and writing */
+  double parseMs;
+  double passMs;
+  double writeMs;
+  bool ok;
+  std::string error;
+
+  Job() : parseMs(0), passMs(0), writeMs(0), ok(false) {}
+};
+
+std::vector<Job> jobs;
+std::vector<const PassInfo *> pipeline;
+volatile sys::cas_flag nextJob = 0;
+
+/* diagnostics of the workers are printed whole */
+ManagedStatic<sys::SmartMutex<true> > OutputLock;
+
+double
+nowMs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/*
+ * Read, transform and write one module. Nothing here is shared with the
+ * other workers except the pass registry and the options, which are only
+ * read.
+ */
+void
+runJob(Job &job)
+{
+  double start = nowMs();
+  LLVMContext context;
+  SMDiagnostic err;
+  OwningPtr<Module> M(ParseIRFile(job.input, err, context));
+  job.parseMs = nowMs() - start;
+  if (!M) {
+    std::string msg;
+    raw_string_ostream os(msg);
+    err.print("sqlrand-opt", os);
+    job.error = os.str();
+    return;
+  }
+
+  start = nowMs();
+  PassManager PM;
+  if (!M->getDataLayout().empty())
+    PM.add(new DataLayout(M->getDataLayout()));
+  for (size_t i = 0; i < pipeline.size(); i++)
+    PM.add(pipeline[i]->createPass());
+  if (!NoVerify)
+    PM.add(createVerifierPass());
+  PM.run(*M);
+  job.passMs = nowMs() - start;
+
+  start = nowMs();
+  std::string errorInfo;
+  tool_output_file out(job.output.c_str(), errorInfo,
+                       raw_fd_ostream::F_Binary);
+  if (!errorInfo.empty()) {
+    job.error = errorInfo;
+    return;
+  }
+  WriteBitcodeToFile(M.get(), out.os());
+  out.os().close();
+  if (out.os().has_error()) {
+    out.os().clear_error();
+    job.error = "could not write " + job.output;
+    return;
+  }
+  out.keep();
+  job.writeMs = nowMs() - start;
+  job.ok = true;
+}
+
+void *
+worker(void *)
+{
+  for (;;) {
+    size_t n = sys::AtomicIncrement(&nextJob) - 1;
+    if (n >= jobs.size())
+      return NULL;
+
+    runJob(jobs[n]);
+    if (!jobs[n].ok) {
+      sys::SmartScopedLock<true> Guard(*OutputLock);
+      errs() << "sqlrand-opt: " << jobs[n].input << ": " << jobs[n].error
+             << "\n";
+    }
+  }
+}
+
+std::string
+getOutputPath(const std::string &input)
+{
+  SmallString<256> path(input);
+  sys::path::replace_extension(path, OutputSuffix);
+  if (OutputDir.empty())
+    return path.str();
+
+  SmallString<256> out(OutputDir);
+  sys::path::append(out, sys::path::filename(path));
+  return out.str();
+}
+
+bool
+readInputList(const std::string &file, std::vector<std::string> &inputs)
+{
+  OwningPtr<MemoryBuffer> buf;
+  if (MemoryBuffer::getFile(file, buf)) {
+    errs() << "sqlrand-opt: cannot read " << file << "\n";
+    return false;
+  }
+
+  SmallVector<StringRef, 64> lines;
+  buf->getBuffer().split(lines, "\n", -1, false);
+  for (size_t i = 0; i < lines.size(); i++) {
+    StringRef line = lines[i].trim();
+    if (!line.empty() && !line.startswith("#"))
+      inputs.push_back(line.str());
+  }
+  return true;
+}
+
+/*
+ * The object a compile command writes: the argument of -o, or the source
+ * with a .o extension, relative to the command's directory.
+ */
+std::string
+getCommandOutput(const std::vector<std::string> &args,
+                 const std::string &dir, const std::string &file)
+{
+  SmallString<256> out;
+  for (size_t i = 0; i + 1 < args.size(); i++)
+    if (args[i] == "-o")
+      out = args[i + 1];
+
+  if (out.empty()) {
+    out = sys::path::filename(file);
+    sys::path::replace_extension(out, "o");
+  }
+  if (!sys::path::is_absolute(out.str())) {
+    SmallString<256> abs(dir);
+    sys::path::append(abs, out.str());
+    out = abs;
+  }
+  return out.str();
+}
+
+bool
+readCompileCommands(const std::string &file, std::vector<std::string> &inputs)
+{
+  OwningPtr<MemoryBuffer> buf;
+  if (MemoryBuffer::getFile(file, buf)) {
+    errs() << "sqlrand-opt: cannot read " << file << "\n";
+    return false;
+  }
+
+  SourceMgr SM;
+  yaml::Stream stream(buf->getBuffer(), SM);
+  yaml::document_iterator doc = stream.begin();
+  if (doc == stream.end())
+    return true;
+
+  yaml::SequenceNode *entries =
+      dyn_cast_or_null<yaml::SequenceNode>(doc->getRoot());
+  if (entries == NULL) {
+    errs() << "sqlrand-opt: " << file << ": expected an array\n";
+    return false;
+  }
+
+  for (yaml::SequenceNode::iterator ei = entries->begin();
+       ei != entries->end();
+       ++ei) {
+    yaml::MappingNode *entry = dyn_cast<yaml::MappingNode>(&*ei);
+    if (entry == NULL) {
+      errs() << "sqlrand-opt: " << file << ": expected an object\n";
+      return false;
+    }
+
+    std::string dir, source;
+    std::vector<std::string> args;
+    for (yaml::MappingNode::iterator ki = entry->begin();
+         ki != entry->end();
+         ++ki) {
+      yaml::ScalarNode *key = dyn_cast<yaml::ScalarNode>(ki->getKey());
+      if (key == NULL)
+        continue;
+      SmallString<16> keyStorage;
+      StringRef name = key->getValue(keyStorage);
+
+      if (yaml::ScalarNode *value =
+              dyn_cast<yaml::ScalarNode>(ki->getValue())) {
+        SmallString<128> storage;
+        StringRef v = value->getValue(storage);
+        if (name == "directory") {
+          dir = v.str();
+        } else if (name == "file") {
+          source = v.str();
+        } else if (name == "command") {
+          /* quoted arguments are not split correctly, nor needed here */
+          SmallVector<StringRef, 32> words;
+          v.split(words, " ", -1, false);
+          for (size_t i = 0; i < words.size(); i++)
+            args.push_back(words[i].str());
+        }
+      } else if (yaml::SequenceNode *value =
+                     dyn_cast<yaml::SequenceNode>(ki->getValue())) {
+        if (name != "arguments")
+          continue;
+        for (yaml::SequenceNode::iterator ai = value->begin();
+             ai != value->end();
+             ++ai) {
+          if (yaml::ScalarNode *arg = dyn_cast<yaml::ScalarNode>(&*ai)) {
+            SmallString<64> storage;
+            args.push_back(arg->getValue(storage).str());
+          }
+        }
+      }
+    }
+
+    if (!source.empty())
+      inputs.push_back(getCommandOutput(args, dir, source));
+  }
+  return true;
+}
+
+long
+getPeakRSSKb()
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  return usage.ru_maxrss;
+}
+
+void
+printReport(raw_ostream &os, unsigned threads, double wallMs)
+{
+  double parse = 0, pass = 0, write = 0;
+  unsigned failed = 0;
+
+  os << format("%-48s %10s %10s %10s\n", "file", "read ms", "passes ms",
+               "write ms");
+  for (size_t i = 0; i < jobs.size(); i++) {
+    const Job &job = jobs[i];
+    os << format("%-48s %10.1f %10.1f %10.1f", job.input.c_str(),
+                 job.parseMs, job.passMs, job.writeMs);
+    if (!job.ok) {
+      os << "  FAILED";
+      failed++;
+    }
+    os << "\n";
+    parse += job.parseMs;
+    pass += job.passMs;
+    write += job.writeMs;
+  }
+
+  double busy = parse + pass + write;
+  os << "\n";
+  os << format("files:          %u (%u failed)\n", (unsigned) jobs.size(),
+               failed);
+  os << format("threads:        %u\n", threads);
+  os << format("read:           %.1f ms\n", parse);
+  os << format("passes:         %.1f ms\n", pass);
+  os << format("write:          %.1f ms\n", write);
+  os << format("wall:           %.1f ms\n", wallMs);
+  os << format("parallelism:    %.2f\n", wallMs > 0 ? busy / wallMs : 0.0);
+  os << format("peak RSS:       %.1f MB\n", getPeakRSSKb() / 1024.0);
+}
+
+} /* ------------------  namespace end ------------------ */
+
+int
+main(int argc, char **argv)
+{
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;
+
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeScalarOpts(Registry);
+  initializeIPO(Registry);
+  initializeAnalysis(Registry);
+  initializeIPA(Registry);
+  initializeTransformUtils(Registry);
+  initializeInstCombine(Registry);
+  initializeInstrumentation(Registry);
+
+  cl::ParseCommandLineOptions(argc, argv, "SQLRand batch driver\n");
+
+  std::vector<std::string> inputs(InputFiles.begin(), InputFiles.end());
+  if (!InputList.empty() && !readInputList(InputList, inputs))
+    return 1;
+  if (!CompileCommands.empty() &&
+      !readCompileCommands(CompileCommands, inputs))
+    return 1;
+  if (inputs.empty()) {
+    errs() << argv[0] << ": no input files\n";
+    return 1;
+  }
+
+  if (PassNames.empty()) {
+    PassNames.push_back("mem2reg");
+    PassNames.push_back("sqlrand-cache");
+    PassNames.push_back("SQLRand");
+  }
+  for (size_t i = 0; i < PassNames.size(); i++) {
+    const PassInfo *PI = Registry.getPassInfo(PassNames[i]);
+    if (PI == NULL || PI->getNormalCtor() == NULL) {
+      errs() << argv[0] << ": unknown pass " << PassNames[i]
+             << " (are the plugins loaded with -load?)\n";
+      return 1;
+    }
+    pipeline.push_back(PI);
+  }
+
+  if (!OutputDir.empty()) {
+    bool existed;
+    if (sys::fs::create_directories(Twine(OutputDir), existed)) {
+      errs() << argv[0] << ": cannot create " << OutputDir << "\n";
+      return 1;
+    }
+  }
+
+  jobs.resize(inputs.size());
+  for (size_t i = 0; i < inputs.size(); i++) {
+    jobs[i].input = inputs[i];
+    jobs[i].output = getOutputPath(inputs[i]);
+  }
+
+  unsigned threads = Jobs;
+  if (threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? cpus : 1;
+  }
+  threads = std::min<size_t>(threads, jobs.size());
+
+  if (!llvm_start_multithreaded() && threads > 1) {
+    errs() << argv[0] << ": LLVM was built without threads, using one\n";
+    threads = 1;
+  }
+
+  double start = nowMs();
+  std::vector<pthread_t> pool(threads);
+  for (unsigned i = 0; i < threads; i++)
+    if (pthread_create(&pool[i], NULL, worker, NULL) != 0) {
+      errs() << argv[0] << ": cannot create a worker thread\n";
+      return 1;
+    }
+  for (unsigned i = 0; i < threads; i++)
+    pthread_join(pool[i], NULL);
+  double wallMs = nowMs() - start;
+
+  bool failed = false;
+  for (size_t i = 0; i < jobs.size(); i++)
+    failed |= !jobs[i].ok;
+
+  if (ReportFile.empty()) {
+    printReport(errs(), threads, wallMs);
+  } else {
+    std::string errorInfo;
+    tool_output_file report(ReportFile.c_str(), errorInfo);
+    if (!errorInfo.empty()) {
+      errs() << argv[0] << ": " << errorInfo << "\n";
+      return 1;
+    }
+    printReport(report.os(), threads, wallMs);
+    report.keep();
+  }
+
+  return failed ? 1 : 0;
+}
@@ -30,16 +30,61 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <ctype.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "postgresql/libpq-fe.h"
 #include "mysql/mysql.h"
 
 #include "sqlrand_helpers.h"
+#include "sqlrand_probes.h"
+
+/*
+ * Locale-independent character classes for SQL lexing, indexed by byte.
+ * A token starts at an ASCII letter or digit and continues over letters,
+ * digits and '_'. Multi-byte UTF-8 sequences are part of identifiers: a
+ * lead byte may start a token and continuation bytes extend it, so
+ * non-ASCII column names stay a single token. Overlong (0xC0, 0xC1) and
+ * out-of-range (0xF5-0xFF) lead bytes never occur in valid UTF-8 and are
+ * treated as separators.
+ *
+ * The SQLRand pass tokenizes literals with the same rules (see
+ * SQLRandPass::sanitizeString); the two must be kept in sync.
+ */
+#define CT_START	0x01	/* may start a token */
+#define CT_IDENT	0x02	/* may continue a token */
+#define CT_UTF8		0x04	/* part of a multi-byte sequence */
+
+#define A	(CT_START | CT_IDENT)
+#define I	CT_IDENT
+#define L	(CT_START | CT_IDENT | CT_UTF8)
+#define T	(CT_IDENT | CT_UTF8)
+static const unsigned char sqlrand_ctype[256] = {
+	/* 0x00 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	/* 0x10 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	/* 0x20 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	/* 0x30 */ A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0, 0,
+	/* 0x40 */ 0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+	/* 0x50 */ A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, I,
+	/* 0x60 */ 0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+	/* 0x70 */ A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0,
+	/* 0x80 */ T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T,
+	/* 0x90 */ T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T,
+	/* 0xA0 */ T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T,
+	/* 0xB0 */ T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T,
+	/* 0xC0 */ 0, 0, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+	/* 0xD0 */ L, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+	/* 0xE0 */ L, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+	/* 0xF0 */ L, L, L, L, L, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+#undef A
+#undef I
+#undef L
+#undef T
 
 int
 isKeyword(char *word, int mysql)
@@ -68,18 +113,163 @@ isKeyword(char *word, int mysql)
 	return 0;
 }
 
+struct sqlrand_registry {
+	const struct sqlrand_mapping *by_hash;
+	const struct sqlrand_mapping *by_key;
+	unsigned int count;
+};
+
+/* indexed by is_mysql; filled by constructors before main() runs */
+static struct sqlrand_registry registry[2][SQLRAND_MAX_MAPPINGS];
+static unsigned int nregistered[2];
+
+static int
+same_mapping(const struct sqlrand_registry *r,
+	     const struct sqlrand_mapping *by_hash, unsigned int count)
+{
+	unsigned int i;
+
+	if (r->count != count)
+		return 0;
+	for (i = 0; i < count; i++)
+		if (strcmp(r->by_hash[i].hash, by_hash[i].hash) != 0 ||
+		    strcmp(r->by_hash[i].key, by_hash[i].key) != 0)
+			return 0;
+	return 1;
+}
+
+/*
+ * Called from the constructor the pass adds to every instrumented module.
+ * Modules built against the same mapping register identical tables; only
+ * the first copy is kept.
+ */
 void
-convert_to_plaintext(char *hash, int is_mysql)
+__sqlrand_register_mapping(int is_mysql, const struct sqlrand_mapping *by_hash,
+			   const struct sqlrand_mapping *by_key,
+			   unsigned int count)
 {
-	if (!hash)
-		return;
+	int d = is_mysql ? 1 : 0;
+	unsigned int i;
+
+	for (i = 0; i < nregistered[d]; i++)
+		if (same_mapping(&registry[d][i], by_hash, count))
+			return;
+
+	if (nregistered[d] == SQLRAND_MAX_MAPPINGS) {
+		fprintf(stderr, "sqlrand: too many keyword mappings\n");
+		exit(EXIT_FAILURE);
+	}
+
+	registry[d][nregistered[d]].by_hash = by_hash;
+	registry[d][nregistered[d]].by_key = by_key;
+	registry[d][nregistered[d]].count = count;
+	nregistered[d]++;
+}
+
+/*
+ * Binary search for @word in @table, sorted on the hash when @to_plain is
+ * set and on the keyword otherwise. Returns the counterpart or NULL.
+ */
+static const char *
+lookup_mapping(const struct sqlrand_mapping *table, unsigned int count,
+	       const char *word, int to_plain)
+{
+	unsigned int lo = 0, hi = count;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		const struct sqlrand_mapping *e = &table[mid];
+		int cmp = strcmp(word, to_plain ? e->hash : e->key);
+
+		if (cmp == 0)
+			return to_plain ? e->key : e->hash;
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return NULL;
+}
+
+/* Convert @word with the table @r; 1 if it has a counterpart there */
+static int
+convert_with(char *word, const struct sqlrand_registry *r, int to_plain)
+{
+	const char *other;
+
+	other = lookup_mapping(to_plain ? r->by_hash : r->by_key, r->count,
+			       word, to_plain);
+	if (other == NULL)
+		return 0;
+
+	if (to_plain)
+		SQLRAND_PROBE1(lookup__hit, word);
+	strncpy(word, other, strlen(word));
+	return 1;
+}
+
+/*
+ * Look @word up in the embedded mappings of dialect @d. The table in
+ * *@mapping, the one that matched last or the one cached for the
+ * connection, is tried first; on a miss every other registered table is,
+ * since one query may hold fragments of modules built with different
+ * mappings. *@mapping is left at the table that matched. Returns -1 when
+ * no module registered a mapping, so the caller falls back to the mapping
+ * file.
+ */
+static int
+convert_embedded(char *word, int d, int to_plain,
+		 const struct sqlrand_registry **mapping)
+{
+	const struct sqlrand_registry *r;
+	unsigned int i;
+
+	if (nregistered[d] == 0)
+		return -1;
+
+	if (*mapping != NULL && convert_with(word, *mapping, to_plain))
+		return 1;
+
+	for (i = 0, r = registry[d]; i < nregistered[d]; i++, r++) {
+		if (r == *mapping)
+			continue;
+		if (convert_with(word, r, to_plain)) {
+			*mapping = r;
+			return 1;
+		}
+	}
+
+	if (to_plain)
+		SQLRAND_PROBE1(lookup__miss, word);
+	return 0;
+}
+
+/*
+ * Replace @word in place with its counterpart: the keyword for a hash when
+ * @to_plain is set, the hash for a keyword otherwise. Both have the same
+ * length, so @word never grows. The embedded mappings are used when
+ * present, the mapping file otherwise. Returns 1 if @word was replaced.
+ */
+static int
+convert_token(char *word, int is_mysql, int to_plain,
+	      const struct sqlrand_registry **mapping)
+{
+	int found;
+
+	if (!word)
+		return 0;
+
+	found = convert_embedded(word, is_mysql == 1, to_plain, mapping);
+	if (found != -1)
+		return found;
 
 	char *line = NULL;
-	char *token = NULL;
+	char *hash, *key;
 	FILE *fp;
 	size_t len = 0;
-	ssize_t read;
+	size_t wlen = strlen(word);
 
+	found = 0;
 	if (is_mysql == 1)
 		fp = fopen(MYSQL_MAPPING_FILE, "r");
 	else
@@ -90,21 +280,125 @@ convert_to_plaintext(char *hash, int is_mysql)
 		exit(EXIT_FAILURE);
 	}
 
-	while((read = getline(&line, &len, fp)) != -1) {
-		token = NULL;
-		token = strtok(line, " ");
-		if (strncasecmp(token, hash, strlen(token)) == 0) {
-			token = strtok(NULL, " ");
-			strncpy(hash, token, strlen(hash));
+	while (getline(&line, &len, fp) != -1) {
+		hash = strtok(line, " ");
+		key = strtok(NULL, " \n");
+		if (hash == NULL || key == NULL)
+			continue;
+		if (to_plain && strcmp(hash, word) == 0) {
+			SQLRAND_PROBE1(lookup__hit, word);
+			strncpy(word, key, wlen);
+			found = 1;
+			break;
+		}
+		if (!to_plain && strcmp(key, word) == 0) {
+			strncpy(word, hash, wlen);
+			found = 1;
 			break;
 		}
 	}
 
+	if (to_plain && !found)
+		SQLRAND_PROBE1(lookup__miss, word);
+
 	free(line);
 	fclose(fp);
+	return found;
+}
+
+void
+convert_to_plaintext(char *hash, int is_mysql)
+{
+	const struct sqlrand_registry *mapping = NULL;
+
+	convert_token(hash, is_mysql, 1, &mapping);
+}
+
+void
+convert_to_hash(char *key, int is_mysql)
+{
+	const struct sqlrand_registry *mapping = NULL;
+
+	convert_token(key, is_mysql, 0, &mapping);
+}
+
+/*
+ * Connection handle (MYSQL * or PGconn *) to the mapping its queries were
+ * last verified with, so a process talking to several databases finds the
+ * right table without searching. Open addressing over a fixed table with a
+ * bounded probe sequence; slots are claimed with a CAS and never freed.
+ * A handle that finds no slot simply is not cached. The cached mapping is
+ * only trusted if it belongs to the dialect of the wrapper being called,
+ * which covers handles whose address is reused by another connection.
+ */
+#define SQLRAND_HANDLE_SLOTS	256	/* power of two */
+#define SQLRAND_HANDLE_PROBES	8
+
+struct sqlrand_handle {
+	const void *conn;
+	const struct sqlrand_registry *mapping;
+};
+
+static struct sqlrand_handle handles[SQLRAND_HANDLE_SLOTS];
+
+static inline unsigned int
+handle_hash(const void *conn)
+{
+	uintptr_t h = (uintptr_t) conn;
+
+	h ^= h >> 16;
+	h *= 0x45d9f3bU;
+	h ^= h >> 16;
+	return (unsigned int) h;
 }
 
-void log_exit(char *input_str)
+static const struct sqlrand_registry *
+handle_mapping(const void *conn, int d)
+{
+	const struct sqlrand_registry *m;
+	const void *c;
+	unsigned int i, slot = handle_hash(conn);
+
+	for (i = 0; i < SQLRAND_HANDLE_PROBES; i++) {
+		struct sqlrand_handle *h =
+		    &handles[(slot + i) & (SQLRAND_HANDLE_SLOTS - 1)];
+
+		c = __atomic_load_n(&h->conn, __ATOMIC_ACQUIRE);
+		if (c == NULL)
+			return NULL;
+		if (c != conn)
+			continue;
+
+		m = __atomic_load_n(&h->mapping, __ATOMIC_ACQUIRE);
+		if (m >= registry[d] && m < registry[d] + nregistered[d])
+			return m;
+		return NULL;
+	}
+	return NULL;
+}
+
+static void
+handle_remember(const void *conn, const struct sqlrand_registry *m)
+{
+	const void *c;
+	unsigned int i, slot = handle_hash(conn);
+
+	for (i = 0; i < SQLRAND_HANDLE_PROBES; i++) {
+		struct sqlrand_handle *h =
+		    &handles[(slot + i) & (SQLRAND_HANDLE_SLOTS - 1)];
+
+		c = NULL;
+		if (__atomic_compare_exchange_n(&h->conn, &c, conn, 0,
+						__ATOMIC_ACQ_REL,
+						__ATOMIC_ACQUIRE) ||
+		    c == conn) {
+			__atomic_store_n(&h->mapping, m, __ATOMIC_RELEASE);
+			return;
+		}
+	}
+}
+
+void log_exit(char *input_str, const struct sqlrand_site *site)
 {
 	FILE *fp;
 	char *log     = "/sqlrand_exit.log";
@@ -138,114 +432,401 @@ void log_exit(char *input_str)
 	}
 
 	fprintf(fp, "CONTROLLED_EXIT: SQL Injection Detected. Aborting..\n");
+	if (site != NULL)
+		fprintf(fp, "Query site %u: %s:%u\n", site->id,
+			site->file != NULL ? site->file : "<unknown>", site->line);
 	fprintf(fp, "Input string was: \n\n %s", input_str);
 	fclose(fp);
 	free(ofile);
 }
 
 /*
-* Check if input is clean from SQL injection and return plaintext
-*/
+ * Streaming de-randomization.
+ *
+ * The query is processed in windows of at most SQLRAND_WINDOW bytes and
+ * rewritten in place: a hash and its keyword have the same length, so the
+ * output never moves. A token cut by the end of a window is kept in the
+ * stream's carry buffer together with a pointer to where its prefix lives,
+ * and is finished once the next window supplies the rest. Tokens longer
+ * than SQLRAND_MAX_TOKEN can be neither a keyword nor a hash and are only
+ * skipped over, so the extra memory is bounded by the carry buffer no
+ * matter how large the query is.
+ */
+static inline int
+is_token_start(char c)
+{
+	return sqlrand_ctype[(unsigned char) c] & CT_START;
+}
+
+static inline int
+is_token_char(char c)
+{
+	return sqlrand_ctype[(unsigned char) c] & CT_IDENT;
+}
+
+/* Only all-ASCII tokens can be a keyword or the hash of one */
+static int
+is_ascii_token(const char *tok, size_t len)
+{
+	unsigned char acc = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		acc |= sqlrand_ctype[(unsigned char) tok[i]];
+	return !(acc & CT_UTF8);
+}
+
 void
-get_plaintext_from_string(char *input, int is_mysql)
+sqlrand_stream_init(struct sqlrand_stream *s, const char *query,
+		    int is_mysql, int to_plain)
 {
-	if (!input)
-		return;
+	memset(s, 0, sizeof(*s));
+	s->query = query;
+	s->is_mysql = is_mysql;
+	s->to_plain = to_plain;
+}
 
-	/* Copy input in another string and work with that */
-	char *hashed_str = (char *) calloc(1, (strlen(input) + 1) * sizeof(char));
-	if (hashed_str == NULL) {
-		perror("calloc str failed!");
-		exit(EXIT_FAILURE);
+/*
+ * Runs of tokens decoded by one table, in the order of the query. They
+ * are few, one unless the query mixes fragments of modules built with
+ * different mappings.
+ */
+struct sqlrand_run {
+	const char *at;		/* first token of the run */
+	const struct sqlrand_registry *mapping;
+};
+
+struct sqlrand_runs {
+	struct sqlrand_run *run;
+	unsigned int n;
+	unsigned int cap;
+};
+
+static void
+record_run(struct sqlrand_runs *runs, const char *at,
+	   const struct sqlrand_registry *mapping)
+{
+	if (runs->n == runs->cap) {
+		unsigned int cap = runs->cap ? 2 * runs->cap : 4;
+		struct sqlrand_run *run =
+		    realloc(runs->run, cap * sizeof(*run));
+
+		if (run == NULL) {
+			perror("realloc runs failed!");
+			exit(EXIT_FAILURE);
+		}
+		runs->run = run;
+		runs->cap = cap;
 	}
+	runs->run[runs->n].at = at;
+	runs->run[runs->n].mapping = mapping;
+	runs->n++;
+}
 
-	strcpy(hashed_str, input);
+/*
+ * Rewrite the complete token @word, which starts at @at in the query, and
+ * abort on a plaintext keyword
+ */
+static void
+process_word(struct sqlrand_stream *s, char *word, const char *at)
+{
+	if (s->to_plain) {
+		/* If we found a keyword abort */
+		if (isKeyword(word, s->is_mysql)) {
+			SQLRAND_PROBE3(injection, s->query, word, s->site);
+			log_exit((char *) s->query, s->site);
+			exit(EXIT_FAILURE);
+		}
+		if (convert_token(word, s->is_mysql, 1, &s->mapping) == 1 &&
+		    s->mapping != s->decoded_by) {
+			if (s->decoded_by != NULL)
+				s->mixed = 1;
+			s->decoded_by = s->mapping;
+			if (s->runs != NULL)
+				record_run(s->runs, at, s->mapping);
+		}
+	} else {
+		/* re-encode with the table that decoded the token */
+		while (s->runs != NULL && s->next_run < s->runs->n &&
+		       s->runs->run[s->next_run].at <= at)
+			s->mapping = s->runs->run[s->next_run++].mapping;
+		convert_token(word, s->is_mysql, 0, &s->mapping);
+	}
+}
 
-	/* make room for plaintext */
-	char *plain = calloc(1, (strlen(input) + 1) * sizeof(char));
-	if (plain == NULL) {
-		perror("plain str failed!");
-		exit(EXIT_FAILURE);
+static void
+process_token(struct sqlrand_stream *s, char *tok, size_t len)
+{
+	char word[SQLRAND_MAX_TOKEN + 1];
+
+	if (len > SQLRAND_MAX_TOKEN || !is_ascii_token(tok, len))
+		return;
+
+	memcpy(word, tok, len);
+	word[len] = '\0';
+	process_word(s, word, tok);
+	memcpy(tok, word, len);
+}
+
+/* Finish the token carried over from the previous window */
+static void
+process_carry(struct sqlrand_stream *s, char *rest, size_t len)
+{
+	char word[SQLRAND_MAX_TOKEN + 1];
+	size_t total = s->carry_len + len;
+
+	s->in_token = 0;
+	if (s->carry_overflow || total > SQLRAND_MAX_TOKEN ||
+	    !is_ascii_token(s->carry, s->carry_len) ||
+	    !is_ascii_token(rest, len))
+		return;
+
+	memcpy(word, s->carry, s->carry_len);
+	memcpy(word + s->carry_len, rest, len);
+	word[total] = '\0';
+	process_word(s, word, s->carry_at);
+
+	memcpy(s->carry_at, word, s->carry_len);
+	memcpy(rest, word + s->carry_len, len);
+}
+
+void
+sqlrand_stream_window(struct sqlrand_stream *s, char *window, size_t len,
+		      int last)
+{
+	size_t i = 0, start;
+
+	if (s->in_token) {
+		while (i < len && is_token_char(window[i]))
+			i++;
+		if (i == len && !last) {
+			/* the token spans a whole window: too long to matter */
+			s->carry_overflow = 1;
+			return;
+		}
+		process_carry(s, window, i);
 	}
 
-	/* read all strings in input */
-	int str_start = 0;
-	char *str = NULL;
-	unsigned int i = 0;
-	unsigned int j;
-	while(i < strlen(input)) {
-		if (isalnum(input[i])) {
-			/* If we found the beginning of a string, go all the way
-			 * and sanitize it if it is a keyword. Ignore anything not
-			 * alphanumeric and append to plain */
-			str_start = i;
-			while (isalnum(input[i]) || input[i] == '_')
-				i++;
-
-			if (str)
-				free(str);
-			/* proper as now i is the \0 character */
-			str = calloc(1, (i - str_start) * sizeof(char));
-			for (j = str_start; j < i; j++) {
-				str[j - str_start] = input[j];
-			}
-			/* If we found a keyword abort */
-			if (isKeyword(str, is_mysql)) {
-				/* log */
-				log_exit(input);
-				exit(EXIT_FAILURE);
-			}
-			convert_to_plaintext(str, is_mysql);
-			strncat(plain, str, i - str_start);
+	while (i < len) {
+		if (!is_token_start(window[i])) {
+			i++;
+			continue;
 		}
-		plain[i] = input[i++];
+
+		start = i;
+		s->tokens++;
+		while (i < len && is_token_char(window[i]))
+			i++;
+
+		if (i == len && !last) {
+			/* token straddles the window boundary */
+			s->in_token = 1;
+			s->carry_at = window + start;
+			s->carry_len = i - start;
+			s->carry_overflow = s->carry_len > SQLRAND_MAX_TOKEN;
+			if (!s->carry_overflow)
+				memcpy(s->carry, window + start, s->carry_len);
+			return;
+		}
+		process_token(s, window + start, i - start);
 	}
+}
 
-	strncpy(input, plain, strlen(input));
+static void
+rewrite_in_windows(struct sqlrand_stream *s, char *input, size_t len)
+{
+	size_t off, chunk;
 
-	if (str)
-		free(str);
-	free(plain);
-	free(hashed_str);
+	for (off = 0; off < len; off += chunk) {
+		chunk = len - off < SQLRAND_WINDOW ? len - off : SQLRAND_WINDOW;
+		sqlrand_stream_window(s, input + off, chunk, off + chunk == len);
+	}
+}
+
+static unsigned long long
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * De-randomize @buf in place, firing the query__start/done probes. @conn,
+ * when given, selects the mapping through the handle cache and learns it
+ * from queries decoded by a single table. @site is the call site of the
+ * query, if known. @runs, if given, receives the tables that decoded
+ * @buf, for rerandomize_query().
+ */
+static void
+verify_query(char *buf, size_t len, const char *query, int is_mysql,
+	     const void *conn, const struct sqlrand_site *site,
+	     struct sqlrand_runs *runs)
+{
+	unsigned long long start = 0;
+	struct sqlrand_stream s;
+	const struct sqlrand_registry *cached = NULL;
+	/* a tracer attaching meanwhile must not see a duration from 0 */
+	int timed = SQLRAND_PROBE_ENABLED(query__done);
+
+	SQLRAND_PROBE4(query__start, query, len, is_mysql, site);
+	if (timed)
+		start = now_ns();
+
+	if (conn != NULL)
+		cached = handle_mapping(conn, is_mysql == 1);
+
+	sqlrand_stream_init(&s, query, is_mysql, 1);
+	s.mapping = cached;
+	s.site = site;
+	s.runs = runs;
+	rewrite_in_windows(&s, buf, len);
+
+	if (conn != NULL && !s.mixed && s.decoded_by != NULL &&
+	    s.decoded_by != cached)
+		handle_remember(conn, s.decoded_by);
+
+	/* an injection never gets here, the query of the site is clean */
+	if (site != NULL && site->verified != NULL)
+		__atomic_store_n(site->verified, 1, __ATOMIC_RELEASE);
+
+	if (timed)
+		SQLRAND_PROBE4(query__done, now_ns() - start, len, s.tokens,
+			       is_mysql);
+	(void) start;
+}
+
+/*
+ * Re-randomize a buffer de-randomized in place by verify_query(), every
+ * token with the table that decoded it, so the caller gets back exactly
+ * what it passed in
+ */
+static void
+rerandomize_query(char *buf, size_t len, int is_mysql,
+		  struct sqlrand_runs *runs)
+{
+	struct sqlrand_stream s;
+
+	sqlrand_stream_init(&s, buf, is_mysql, 0);
+	s.runs = runs;
+	rewrite_in_windows(&s, buf, len);
+}
+
+/*
+* Check if input is clean from SQL injection and turn it into plaintext,
+* in place
+*/
+void
+get_plaintext_from_string(char *input, size_t len, int is_mysql)
+{
+	if (!input)
+		return;
+
+	verify_query(input, len, input, is_mysql, NULL, NULL, NULL);
+}
+
+/*
+ * Large dynamically built queries may be de-randomized directly in the
+ * caller's buffer instead of in a private copy. This is opt-in through
+ * $SQLRAND_INPLACE since the buffer must be writable; it is re-randomized
+ * once the query has been sent, so the caller never sees the plaintext.
+ * Constant queries live in read-only memory and are always copied.
+ */
+static int
+use_inplace(size_t len, const struct sqlrand_site *site)
+{
+	if (site != NULL && (site->flags & SQLRAND_SITE_CONST_QUERY))
+		return 0;
+	return len >= SQLRAND_INPLACE_THRESHOLD &&
+		getenv(SQLRAND_INPLACE) != NULL;
+}
+
+static char *
+plaintext_copy(const char *input, size_t len, int is_mysql, const void *conn,
+	       const struct sqlrand_site *site)
+{
+	char *plain = malloc(len + 1);
+	if (plain == NULL) {
+		perror("malloc str failed!");
+		exit(EXIT_FAILURE);
+	}
+
+	memcpy(plain, input, len);
+	plain[len] = '\0';
+	verify_query(plain, len, input, is_mysql, conn, site, NULL);
+	return plain;
 }
 
 int
-__sqlrand_mysql_real_query(MYSQL *sql, const char *input, unsigned long length)
+__sqlrand_mysql_real_query(MYSQL *sql, const char *input, unsigned long length,
+			   const struct sqlrand_site *site)
 {
-	char *plain = calloc(1, (strlen(input) + 1) * sizeof(char));
-	strcpy(plain, input);
+	int mysql_ret;
 
-	get_plaintext_from_string(plain, 1);
+	if (use_inplace(length, site)) {
+		char *buf = (char *) input;
+		struct sqlrand_runs runs = { NULL, 0, 0 };
 
-	int mysql_ret = mysql_real_query(sql, plain, length);
+		verify_query(buf, length, input, 1, sql, site, &runs);
+		mysql_ret = mysql_real_query(sql, buf, length);
+		rerandomize_query(buf, length, 1, &runs);
+		free(runs.run);
+		return mysql_ret;
+	}
+
+	char *plain = plaintext_copy(input, length, 1, sql, site);
+	mysql_ret = mysql_real_query(sql, plain, length);
 
 	free(plain);
 	return mysql_ret;
 }
 
 int
-__sqlrand_mysql_query(MYSQL *sql, const char *input)
+__sqlrand_mysql_query(MYSQL *sql, const char *input,
+		      const struct sqlrand_site *site)
 {
-	char *plain = calloc(1, (strlen(input) + 1) * sizeof(char));
-	strcpy(plain, input);
-
-	get_plaintext_from_string(plain, 1);
+	int mysql_ret;
+	size_t length = strlen(input);
+
+	if (use_inplace(length, site)) {
+		char *buf = (char *) input;
+		struct sqlrand_runs runs = { NULL, 0, 0 };
+
+		verify_query(buf, length, input, 1, sql, site, &runs);
+		mysql_ret = mysql_query(sql, buf);
+		rerandomize_query(buf, length, 1, &runs);
+		free(runs.run);
+		return mysql_ret;
+	}
 
-	int mysql_ret = mysql_query(sql, plain);
+	char *plain = plaintext_copy(input, length, 1, sql, site);
+	mysql_ret = mysql_query(sql, plain);
 
 	free(plain);
 	return mysql_ret;
 }
 
 PGresult *
-__sqlrand_PQexec(PGconn *conn, const char *input)
+__sqlrand_PQexec(PGconn *conn, const char *input,
+		 const struct sqlrand_site *site)
 {
-	char *plain = calloc(1, (strlen(input) + 1) * sizeof(char));
-	strcpy(plain, input);
-
-	get_plaintext_from_string(plain, 0);
+	PGresult *pq_ret;
+	size_t length = strlen(input);
+
+	if (use_inplace(length, site)) {
+		char *buf = (char *) input;
+		struct sqlrand_runs runs = { NULL, 0, 0 };
+
+		verify_query(buf, length, input, 0, conn, site, &runs);
+		pq_ret = PQexec(conn, buf);
+		rerandomize_query(buf, length, 0, &runs);
+		free(runs.run);
+		return pq_ret;
+	}
 
-	PGresult *pq_ret = PQexec(conn, plain);
+	char *plain = plaintext_copy(input, length, 0, conn, site);
+	pq_ret = PQexec(conn, plain);
 
 	free(plain);
 	return pq_ret;
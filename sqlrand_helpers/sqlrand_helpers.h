@@ -30,11 +30,57 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <boost/algorithm/string.hpp>
 const char *MYSQL_MAPPING_FILE = "/tmp/.sqlrand_mysql";
 const char *PGSQL_MAPPING_FILE = "/tmp/.sqlrand_pgsql";
 const char *SS_TC_ROOT         = "SS_TC_ROOT";
 const char *TMP_FILE           = "/tmp";
+const char *SQLRAND_INPLACE    = "SQLRAND_INPLACE";
+
+/* longest token that can be a keyword or the hash of one */
+#define SQLRAND_MAX_TOKEN		32
+/* queries are de-randomized SQLRAND_WINDOW bytes at a time */
+#ifndef SQLRAND_WINDOW
+#define SQLRAND_WINDOW			(64 * 1024)
+#endif
+/* queries from this size on may be rewritten in the caller's buffer */
+#ifndef SQLRAND_INPLACE_THRESHOLD
+#define SQLRAND_INPLACE_THRESHOLD	(1024 * 1024)
+#endif
+
+#if SQLRAND_WINDOW <= SQLRAND_MAX_TOKEN
+#error "SQLRAND_WINDOW must be larger than SQLRAND_MAX_TOKEN"
+#endif
+
+/*
+ * State carried between the windows of one query: a token cut by the
+ * window boundary is copied to @carry and written back to @carry_at once
+ * the rest of it has been seen. @decoded_by is the table that decoded the
+ * last token, and @mixed is set once tokens of one query were decoded by
+ * different tables. With @runs, the start of every run of tokens decoded
+ * by one table is recorded there, so that the query can be re-randomized
+ * exactly as it was (see rerandomize_query()).
+ */
+struct sqlrand_registry;
+struct sqlrand_site;
+struct sqlrand_runs;
+
+struct sqlrand_stream {
+	const char *query;
+	const struct sqlrand_site *site;	/* NULL if unknown */
+	const struct sqlrand_registry *mapping;	/* embedded table in use */
+	const struct sqlrand_registry *decoded_by;
+	int mixed;
+	struct sqlrand_runs *runs;		/* NULL unless recorded */
+	unsigned int next_run;
+	int is_mysql;
+	int to_plain;
+	int in_token;
+	int carry_overflow;
+	char *carry_at;
+	size_t carry_len;
+	size_t tokens;
+	char carry[SQLRAND_MAX_TOKEN];
+};
 
 const char *MYSQL_KEYWORDS[] = {"ADD", "ALL", "ALTER", "ANALYZE" ,
 	"AND", "AS", "ASC", "ASENSITIVE", "BEFORE", "BETWEEN", "BIGINT" ,
@@ -138,13 +184,77 @@ const char *PSQL_KEYWORDS[] = {
 	"XMLEXISTS", "XMLFOREST", "XMLPARSE", "XMLPI", "XMLROOT", "XMLSERIALIZE",
 	"YEAR_P", "YES_P", "ZONE", NULL};
 
+/*
+ * One entry of a keyword mapping embedded by the SQLRand pass. Every
+ * instrumented module carries its mapping twice, sorted by hash and sorted
+ * by keyword, and registers both from a constructor; lookups are binary
+ * searches over them. The mapping files are only read for modules that
+ * registered nothing.
+ */
+struct sqlrand_mapping {
+	const char *hash;
+	const char *key;
+};
+
+#define SQLRAND_MAX_MAPPINGS	16
+
+void __sqlrand_register_mapping(int is_mysql,
+				const struct sqlrand_mapping *by_hash,
+				const struct sqlrand_mapping *by_key,
+				unsigned int count);
+
+/*
+ * Call site of a rewritten query. The pass emits one constant descriptor
+ * per site and passes it as the last argument of the __sqlrand_ wrapper
+ * the site calls, so the runtime can tell sites apart (caches, metrics,
+ * policies) by the descriptor's address without hashing the query. @id is
+ * unique within the module; @file is NULL when the module has no debug
+ * info. For a constant query the pass may also emit a fast path that sends
+ * a plaintext copy of the query, built at compile time, directly once
+ * *@verified is set; the runtime sets it after the first successful check
+ * of the site. @verified is NULL for every other site.
+ */
+struct sqlrand_site {
+	unsigned int id;
+	unsigned int line;
+	const char *file;
+	int is_mysql;
+	unsigned int flags;
+	unsigned int *verified;
+};
+
+/* the query of the site is a literal of the module */
+#define SQLRAND_SITE_CONST_QUERY	0x1
+
 int isKeyword(char *word, int type);
 void convert_to_plaintext(char *msg, int type);
-void log_exit(char *input);
-void get_plaintext_from_string(char *input, int type);
+void convert_to_hash(char *msg, int type);
+void log_exit(char *input, const struct sqlrand_site *site);
+void get_plaintext_from_string(char *input, size_t len, int type);
 
-int __sqlrand_mysql_real_query(MYSQL *sql, const char *in, unsigned long len);
-int __sqlrand_mysql_query(MYSQL *mysql, const char *input);
+void sqlrand_stream_init(struct sqlrand_stream *s, const char *query,
+			 int type, int to_plain);
+void sqlrand_stream_window(struct sqlrand_stream *s, char *window,
+			   size_t len, int last);
+
+/*
+ * COPY ... FROM STDIN and LOAD DATA LOCAL INFILE commands are verified by the
+ * wrappers below like any other statement. Their payload (PQputCopyData, the
+ * local infile stream) is never routed through the runtime.
+ *
+ * With $SQLRAND_INPLACE set, queries of SQLRAND_INPLACE_THRESHOLD bytes or
+ * more are de-randomized in @input itself and re-randomized after they have
+ * been sent, so @input must then be a writable buffer owned by the caller
+ * that no other thread reads meanwhile. Sites whose query is a constant
+ * (SQLRAND_SITE_CONST_QUERY) are always copied. An injection found in that
+ * mode is logged from @input as it is then, de-randomized up to the
+ * offending token.
+ */
+int __sqlrand_mysql_real_query(MYSQL *sql, const char *in, unsigned long len,
+			       const struct sqlrand_site *site);
+int __sqlrand_mysql_query(MYSQL *mysql, const char *input,
+			  const struct sqlrand_site *site);
 
 PGresult *
-__sqlrand_PQexec(PGconn *conn, const char *input);
+__sqlrand_PQexec(PGconn *conn, const char *input,
+		 const struct sqlrand_site *site);
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * USDT (SystemTap / bpftrace) probes of the SQLRand runtime.
+ *
+ * When <sys/sdt.h> is available every probe is a single NOP plus an ELF note
+ * until a tracer attaches. Work that only feeds a probe (e.g. timing a
+ * query) is guarded by the probe's semaphore, which the tracer increments
+ * while it is attached. Without <sys/sdt.h>, or with -DSQLRAND_NO_USDT, the
+ * probes compile away entirely.
+ *
+ * Probes (provider "sqlrand"):
+ *   query__start(const char *query, size_t len, int is_mysql,
+ *                const struct sqlrand_site *site)
+ *   query__done(u64 duration_ns, size_t len, size_t tokens, int is_mysql)
+ *   lookup__hit(const char *token)     token found in the keyword mapping
+ *   lookup__miss(const char *token)    token is not a hash of a keyword
+ *   injection(const char *query, const char *keyword,
+ *             const struct sqlrand_site *site)
+ */
+
+#ifndef __SQLRAND_PROBES_H__
+#define __SQLRAND_PROBES_H__
+
+#if !defined(SQLRAND_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define SQLRAND_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef SQLRAND_HAVE_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define SQLRAND_SEMAPHORE(name) \
+	unsigned short sqlrand_##name##_semaphore \
+	__attribute__((unused)) __attribute__((section(".probes")))
+
+SQLRAND_SEMAPHORE(query__start);
+SQLRAND_SEMAPHORE(query__done);
+SQLRAND_SEMAPHORE(lookup__hit);
+SQLRAND_SEMAPHORE(lookup__miss);
+SQLRAND_SEMAPHORE(injection);
+
+#define SQLRAND_PROBE_ENABLED(name) \
+	__builtin_expect(sqlrand_##name##_semaphore, 0)
+#define SQLRAND_PROBE1(name, a)		STAP_PROBE1(sqlrand, name, a)
+#define SQLRAND_PROBE2(name, a, b)	STAP_PROBE2(sqlrand, name, a, b)
+#define SQLRAND_PROBE3(name, a, b, c)	STAP_PROBE3(sqlrand, name, a, b, c)
+#define SQLRAND_PROBE4(name, a, b, c, d) \
+	STAP_PROBE4(sqlrand, name, a, b, c, d)
+
+#else
+
+#define SQLRAND_PROBE_ENABLED(name)	0
+#define SQLRAND_PROBE1(name, a)		do { } while (0)
+#define SQLRAND_PROBE2(name, a, b)	do { } while (0)
+#define SQLRAND_PROBE3(name, a, b, c)	do { } while (0)
+#define SQLRAND_PROBE4(name, a, b, c, d) do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Minimal stand-in for the libmysqlclient API. Only the subset used by the
+ * sample applications and the SQLRand runtime is provided; queries are
+ * accepted unconditionally and answered with a canned result set.
+ */
+
+#ifndef __SQLRAND_STUB_MYSQL_H__
+#define __SQLRAND_STUB_MYSQL_H__
+
+typedef char **MYSQL_ROW;
+typedef unsigned long long my_ulonglong;
+
+typedef struct st_mysql {
+	unsigned long queries;
+	unsigned long bytes;
+	char error[64];
+} MYSQL;
+
+typedef struct st_mysql_res {
+	my_ulonglong row_count;
+	my_ulonglong current_row;
+	MYSQL_ROW row;
+} MYSQL_RES;
+
+MYSQL *mysql_init(MYSQL *mysql);
+MYSQL *mysql_real_connect(MYSQL *mysql, const char *host, const char *user,
+			  const char *passwd, const char *db, unsigned int port,
+			  const char *unix_socket, unsigned long clientflag);
+int mysql_query(MYSQL *mysql, const char *q);
+int mysql_real_query(MYSQL *mysql, const char *q, unsigned long length);
+MYSQL_RES *mysql_store_result(MYSQL *mysql);
+my_ulonglong mysql_num_rows(MYSQL_RES *res);
+MYSQL_ROW mysql_fetch_row(MYSQL_RES *res);
+void mysql_free_result(MYSQL_RES *res);
+const char *mysql_error(MYSQL *mysql);
+void mysql_close(MYSQL *sock);
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Minimal stand-in for the libpq API. Only the subset used by the sample
+ * applications and the SQLRand runtime is provided; commands are accepted
+ * unconditionally and answered with a canned result.
+ */
+
+#ifndef __SQLRAND_STUB_LIBPQ_FE_H__
+#define __SQLRAND_STUB_LIBPQ_FE_H__
+
+typedef enum {
+	CONNECTION_OK,
+	CONNECTION_BAD
+} ConnStatusType;
+
+typedef enum {
+	PGRES_EMPTY_QUERY = 0,
+	PGRES_COMMAND_OK,
+	PGRES_TUPLES_OK,
+	PGRES_COPY_OUT,
+	PGRES_COPY_IN,
+	PGRES_BAD_RESPONSE,
+	PGRES_NONFATAL_ERROR,
+	PGRES_FATAL_ERROR
+} ExecStatusType;
+
+typedef struct pg_conn {
+	ConnStatusType status;
+	unsigned long queries;
+	unsigned long bytes;
+} PGconn;
+
+typedef struct pg_result {
+	ExecStatusType status;
+	int ntuples;
+} PGresult;
+
+PGconn *PQconnectdb(const char *conninfo);
+ConnStatusType PQstatus(const PGconn *conn);
+char *PQerrorMessage(const PGconn *conn);
+PGresult *PQexec(PGconn *conn, const char *query);
+ExecStatusType PQresultStatus(const PGresult *res);
+int PQntuples(const PGresult *res);
+char *PQgetvalue(const PGresult *res, int tup_num, int field_num);
+int PQputCopyData(PGconn *conn, const char *buffer, int nbytes);
+int PQputCopyEnd(PGconn *conn, const char *errormsg);
+void PQclear(PGresult *res);
+void PQfinish(PGconn *conn);
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mysql/mysql.h"
+
+/*
+ * Stand-in libmysqlclient: every query succeeds and every result set holds
+ * a single row. Set SQLRAND_STUB_TRACE to echo the received statements,
+ * which is handy to check what actually reaches the "server".
+ */
+
+static char *canned_row[] = { "1", NULL };
+
+static void
+stub_trace(const char *q, unsigned long length)
+{
+	if (getenv("SQLRAND_STUB_TRACE"))
+		fprintf(stderr, "[mysql-stub] %.*s\n", (int) length, q);
+}
+
+MYSQL *
+mysql_init(MYSQL *mysql)
+{
+	if (mysql == NULL) {
+		mysql = calloc(1, sizeof(MYSQL));
+		if (mysql == NULL)
+			return NULL;
+	} else {
+		memset(mysql, 0, sizeof(MYSQL));
+	}
+	return mysql;
+}
+
+MYSQL *
+mysql_real_connect(MYSQL *mysql, const char *host, const char *user,
+		   const char *passwd, const char *db, unsigned int port,
+		   const char *unix_socket, unsigned long clientflag)
+{
+	return mysql;
+}
+
+int
+mysql_real_query(MYSQL *mysql, const char *q, unsigned long length)
+{
+	if (mysql == NULL || q == NULL)
+		return 1;
+
+	mysql->queries++;
+	mysql->bytes += length;
+	stub_trace(q, length);
+	return 0;
+}
+
+int
+mysql_query(MYSQL *mysql, const char *q)
+{
+	if (q == NULL)
+		return 1;
+	return mysql_real_query(mysql, q, strlen(q));
+}
+
+MYSQL_RES *
+mysql_store_result(MYSQL *mysql)
+{
+	MYSQL_RES *res = calloc(1, sizeof(MYSQL_RES));
+	if (res == NULL)
+		return NULL;
+
+	res->row_count = 1;
+	res->row = canned_row;
+	return res;
+}
+
+my_ulonglong
+mysql_num_rows(MYSQL_RES *res)
+{
+	return res ? res->row_count : 0;
+}
+
+MYSQL_ROW
+mysql_fetch_row(MYSQL_RES *res)
+{
+	if (res == NULL || res->current_row >= res->row_count)
+		return NULL;
+
+	res->current_row++;
+	return res->row;
+}
+
+void
+mysql_free_result(MYSQL_RES *res)
+{
+	free(res);
+}
+
+const char *
+mysql_error(MYSQL *mysql)
+{
+	return mysql ? mysql->error : "";
+}
+
+void
+mysql_close(MYSQL *sock)
+{
+	free(sock);
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2014, Columbia University
+ * All rights reserved.
+ *
+ * This software was developed by Theofilos Petsios <theofilos@cs.columbia.edu>
+ * at Columbia University, New York, NY, USA, in September 2014.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Columbia University nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "postgresql/libpq-fe.h"
+
+/*
+ * Stand-in libpq: every command succeeds, SELECTs return a single tuple.
+ * Set SQLRAND_STUB_TRACE to echo the received commands.
+ */
+
+static char canned_value[] = "1";
+static char no_error[] = "";
+
+PGconn *
+PQconnectdb(const char *conninfo)
+{
+	PGconn *conn = calloc(1, sizeof(PGconn));
+	if (conn == NULL)
+		return NULL;
+
+	conn->status = CONNECTION_OK;
+	return conn;
+}
+
+ConnStatusType
+PQstatus(const PGconn *conn)
+{
+	return conn ? conn->status : CONNECTION_BAD;
+}
+
+char *
+PQerrorMessage(const PGconn *conn)
+{
+	return no_error;
+}
+
+PGresult *
+PQexec(PGconn *conn, const char *query)
+{
+	if (conn == NULL || query == NULL)
+		return NULL;
+
+	PGresult *res = calloc(1, sizeof(PGresult));
+	if (res == NULL)
+		return NULL;
+
+	conn->queries++;
+	conn->bytes += strlen(query);
+	if (getenv("SQLRAND_STUB_TRACE"))
+		fprintf(stderr, "[pq-stub] %s\n", query);
+
+	if (strncasecmp(query, "SELECT", 6) == 0) {
+		res->status = PGRES_TUPLES_OK;
+		res->ntuples = 1;
+	} else if (strncasecmp(query, "COPY", 4) == 0) {
+		res->status = PGRES_COPY_IN;
+	} else {
+		res->status = PGRES_COMMAND_OK;
+	}
+	return res;
+}
+
+ExecStatusType
+PQresultStatus(const PGresult *res)
+{
+	return res ? res->status : PGRES_FATAL_ERROR;
+}
+
+int
+PQntuples(const PGresult *res)
+{
+	return res ? res->ntuples : 0;
+}
+
+char *
+PQgetvalue(const PGresult *res, int tup_num, int field_num)
+{
+	return canned_value;
+}
+
+int
+PQputCopyData(PGconn *conn, const char *buffer, int nbytes)
+{
+	if (conn == NULL || nbytes < 0)
+		return -1;
+
+	conn->bytes += nbytes;
+	return 1;
+}
+
+int
+PQputCopyEnd(PGconn *conn, const char *errormsg)
+{
+	return conn ? 1 : -1;
+}
+
+void
+PQclear(PGresult *res)
+{
+	free(res);
+}
+
+void
+PQfinish(PGconn *conn)
+{
+	free(conn);
+}